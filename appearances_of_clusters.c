@@ -6,12 +6,13 @@
  */
 
 /* This program reads pentagonal adjacency graphs of fullerenes from 
- * standard in and searches for realisations of a specific partition of 12.   
+ * standard in and searches for realisations of a specific partition of 12 (or
+ * of the number of pentagons given with --pentagons).   
  * 
  * 
  * Compile with:
  *     
- *     cc -o appearances_of_clusters -O4 appearances_of_clusters.c
+ *     cc -o appearances_of_clusters -O4 appearances_of_clusters.c output.c stats.c progress.c input.c parallel.c -pthread -lz -llzma
  * 
  */
 
@@ -20,13 +21,19 @@
 #include <getopt.h>
 #include <string.h>
 
+#include "output.h"
+#include "stats.h"
+#include "progress.h"
+#include "input.h"
+#include "parallel.h"
+
 
 #ifndef MAXN
-#define MAXN 12            /* the maximum number of vertices */
+#define MAXN 12            /* the initial maximum number of vertices */
 #endif
-#define MAXE (6*MAXN-12)    /* the maximum number of oriented edges */
-#define MAXVAL (MAXN-1)  /* the maximum degree of a vertex */
-#define MAXCODELENGTH (MAXN+MAXE+3)
+#define EDGECOUNT(n) (6*(n)-12)    /* the maximum number of oriented edges */
+#define MAXVAL (maxn-1)  /* the maximum degree of a vertex */
+#define CODELENGTH(n) ((n)+EDGECOUNT(n)+3)
 
 #define FALSE 0
 #define TRUE  1
@@ -42,21 +49,62 @@ typedef struct e /* The data type used for edges */ {
     struct e *inverse; /* the edge that is inverse to this one */
 } EDGE;
 
-EDGE *firstedge[MAXN]; /* pointer to arbitrary edge out of vertex i. */
-int degree[MAXN];
+/* The storage for the graphs is sized at runtime. The static arrays are used
+ * as long as the graphs have at most MAXN vertices. Once a larger graph is read
+ * (or a larger size is requested with --max-n) the storage moves to the heap,
+ * where it is reused for all later graphs. Each thread has its own storage,
+ * which is attached on the first call to ensureCapacity.
+ */
+__thread int maxn = MAXN; /* the number of vertices for which storage is available */
+
+__thread EDGE *firstedgeStorage[MAXN];
+__thread int degreeStorage[MAXN];
+__thread EDGE edgesStorage[EDGECOUNT(MAXN)];
+
+__thread EDGE **firstedge = NULL; /* pointer to arbitrary edge out of vertex i. */
+__thread int *degree = NULL;
 
-EDGE edges[MAXE];
+__thread EDGE *edges = NULL;
 
 int numberOfGraphs = 0;
 int numberOfAppearancesOfRequestedPartition = 0;
 
-int nv;
-int ne;
+boolean writeOriginals = FALSE; /* the input contains the original graphs */
+
+/* Writes the rank of a graph that matches, or its original graph when the
+ * input contains the original graphs.
+ */
+void writeMatch(int rank, unsigned short *original, int originalLength){
+    if(writeOriginals){
+        writePlanarCode(original, originalLength);
+    } else {
+        writeInt(rank);
+        writeByte(' ');
+    }
+}
+
+__thread int nv;
+__thread int ne;
 
 int requestedPartition;
 
-/* Below we list how many clusters of a given size are possible in a fullerene.
- * 
+/* Writes the number of appearances for a progress report. */
+void reportAppearanceCount(FILE *f){
+    int count = __atomic_load_n(&numberOfAppearancesOfRequestedPartition, __ATOMIC_RELAXED);
+    fprintf(f, "Found %d appearance%s of partition %d so far.\n", count,
+            count==1 ? "" : "s", requestedPartition);
+}
+
+/* The number of pentagons, i.e., the number of vertices in each pentagonal
+ * adjacency graph. This is 12 for fullerenes and 6 for nanotube caps.
+ */
+int pentagonCount = 12;
+
+/* A partition of pentagonCount is stored as the number of clusters of each
+ * size. There are at most pentagonCount/s clusters of size s, so a partition
+ * can be numbered as a mixed radix number in which the digit for size s has
+ * base pentagonCount/s + 1. For fullerenes this gives the following ranges.
+ *
  *  1: 0 - 12
  *  2: 0 -  6
  *  3: 0 -  4
@@ -69,62 +117,154 @@ int requestedPartition;
  * 10: 0 -  1
  * 11: 0 -  1
  * 12: 0 -  1
+ *
+ * partitionWeight[s-1] is the weight of the digit for size s. As long as the
+ * product of the bases is at most MAXDIRECTTABLESIZE, the number of a partition
+ * is looked up directly in partitions2Number. Otherwise the possible keys are
+ * sorted in partitionKeys and looked up using binary search.
  */
-int partitions2Number[13][7][5][4][3][3][2][2][2][2][2][2];
+#define MAXDIRECTTABLESIZE (1<<22)
+
+typedef unsigned long long PARTITIONKEY;
 
-int possiblePartitions[77][12];
+PARTITIONKEY *partitionWeight;
+PARTITIONKEY partitionKeyRange;
+
+int *partitions2Number = NULL;
+PARTITIONKEY *partitionKeys = NULL;
+int *partitionKeyNumbers = NULL;
+
+int *possiblePartitions; /* the partition with number i starts at i*pentagonCount */
 int possiblePartitionCount;
-int currentPossiblePartition[12];
+int possiblePartitionCapacity;
+int *currentPossiblePartition;
+
+void *allocate(size_t count, size_t size){
+    void *storage = calloc(count, size);
+    if(storage == NULL){
+        fprintf(stderr, "Insufficient memory for the partition tables -- exiting!\n");
+        exit(1);
+    }
+    return storage;
+}
 
-void buildPartitions_recursive(int currentSize){
+void storePossiblePartition(){
     int i;
-    int sum = 0;
-    for(i=0; i<12; i++){
-        sum+=(i+1)*currentPossiblePartition[i];
-    }
-    if(sum==12){
-        for(i=0; i<12; i++){
-            possiblePartitions[possiblePartitionCount][i] = currentPossiblePartition[i];
+    if(possiblePartitionCount == possiblePartitionCapacity){
+        possiblePartitionCapacity *= 2;
+        possiblePartitions = realloc(possiblePartitions,
+                possiblePartitionCapacity * pentagonCount * sizeof(int));
+        if(possiblePartitions == NULL){
+            fprintf(stderr, "Insufficient memory for the partition tables -- exiting!\n");
+            exit(1);
         }
-        partitions2Number[currentPossiblePartition[0]]
-                  [currentPossiblePartition[1]]
-                  [currentPossiblePartition[2]]
-                  [currentPossiblePartition[3]]
-                  [currentPossiblePartition[4]]
-                  [currentPossiblePartition[5]]
-                  [currentPossiblePartition[6]]
-                  [currentPossiblePartition[7]]
-                  [currentPossiblePartition[8]]
-                  [currentPossiblePartition[9]]
-                  [currentPossiblePartition[10]]
-                  [currentPossiblePartition[11]] = possiblePartitionCount;
-        possiblePartitionCount++;
+    }
+    for(i=0; i<pentagonCount; i++){
+        possiblePartitions[possiblePartitionCount*pentagonCount + i] = currentPossiblePartition[i];
+    }
+    possiblePartitionCount++;
+}
+
+void buildPartitions_recursive(int currentSize, int sum){
+    if(sum==pentagonCount){
+        storePossiblePartition();
         return;
     }
-    if(sum + currentSize <= 12){
+    if(sum + currentSize <= pentagonCount){
         currentPossiblePartition[currentSize-1]++;
-        buildPartitions_recursive(currentSize);
+        buildPartitions_recursive(currentSize, sum + currentSize);
         currentPossiblePartition[currentSize-1]--;
     }
     if(currentSize > 1){
-        buildPartitions_recursive(currentSize-1);
+        buildPartitions_recursive(currentSize-1, sum);
     }
 }
 
+PARTITIONKEY getPartitionKey(int *partition){
+    int i;
+    PARTITIONKEY key = 0;
+    for(i=0; i<pentagonCount; i++){
+        key += partition[i]*partitionWeight[i];
+    }
+    return key;
+}
+
+int comparePartitionKeys(const void *a, const void *b){
+    PARTITIONKEY keyA = partitionKeys[*(int *)a];
+    PARTITIONKEY keyB = partitionKeys[*(int *)b];
+    return keyA < keyB ? -1 : (keyA > keyB);
+}
+
+/* Builds the tables for all partitions of pentagonCount. The partitions are
+ * numbered in the same order for every run, so the numbers can be used to
+ * refer to partitions.
+ */
 void buildPartitions(){
     int i;
-    for(i=0; i<12; i++){
-        currentPossiblePartition[i]=0;
+    
+    partitionWeight = allocate(pentagonCount, sizeof(PARTITIONKEY));
+    partitionKeyRange = 1;
+    for(i=0; i<pentagonCount; i++){
+        partitionWeight[i] = partitionKeyRange;
+        if(partitionKeyRange > ~0ULL / (pentagonCount/(i+1) + 1)){
+            fprintf(stderr, "Partitions of %d are not supported -- exiting!\n", pentagonCount);
+            exit(1);
+        }
+        partitionKeyRange *= pentagonCount/(i+1) + 1;
     }
+    
+    currentPossiblePartition = allocate(pentagonCount, sizeof(int));
+    possiblePartitionCapacity = 64;
+    possiblePartitions = allocate(possiblePartitionCapacity * pentagonCount, sizeof(int));
     possiblePartitionCount = 0;
-    buildPartitions_recursive(12);
+    buildPartitions_recursive(pentagonCount, 0);
+    
+    if(partitionKeyRange <= MAXDIRECTTABLESIZE){
+        partitions2Number = allocate(partitionKeyRange, sizeof(int));
+        for(i=0; i<possiblePartitionCount; i++){
+            partitions2Number[getPartitionKey(possiblePartitions + i*pentagonCount)] = i;
+        }
+    } else {
+        int *order = allocate(possiblePartitionCount, sizeof(int));
+        PARTITIONKEY *keys = allocate(possiblePartitionCount, sizeof(PARTITIONKEY));
+        partitionKeys = allocate(possiblePartitionCount, sizeof(PARTITIONKEY));
+        partitionKeyNumbers = allocate(possiblePartitionCount, sizeof(int));
+        for(i=0; i<possiblePartitionCount; i++){
+            partitionKeys[i] = getPartitionKey(possiblePartitions + i*pentagonCount);
+            order[i] = i;
+        }
+        qsort(order, possiblePartitionCount, sizeof(int), comparePartitionKeys);
+        for(i=0; i<possiblePartitionCount; i++){
+            keys[i] = partitionKeys[order[i]];
+            partitionKeyNumbers[i] = order[i];
+        }
+        free(partitionKeys);
+        free(order);
+        partitionKeys = keys;
+    }
+}
+
+int getPartitionNumber(PARTITIONKEY key){
+    if(partitions2Number != NULL){
+        return partitions2Number[key];
+    }
+    int low = 0, high = possiblePartitionCount - 1;
+    while(low < high){
+        int middle = (low + high)/2;
+        if(partitionKeys[middle] < key){
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return partitionKeyNumbers[low];
 }
 
 void printPartition(FILE *f, int part, boolean newline){
     int i, j;
     
-    for(i = 11; i >= 0; i--){
-        for(j = 0; j < possiblePartitions[part][i]; j++){
+    for(i = pentagonCount - 1; i >= 0; i--){
+        for(j = 0; j < possiblePartitions[part*pentagonCount + i]; j++){
             fprintf(f, "%d ", i+1);
         }
     }
@@ -132,16 +272,13 @@ void printPartition(FILE *f, int part, boolean newline){
         fprintf(f, "\n");
 }
 
-
 //////////////////////////////////////////////////////////////////////////////
 
 //=============== Checking for property ===========================
 
-int currentPartition[12];
-
-boolean visited[12];
-boolean currentCluster[12];
-int currentClusterSize;
+__thread boolean *visited;
+__thread int *stack;
+__thread int currentClusterSize;
 
 //some macros for the stack in the next method
 #define PUSH(stack, value) stack[top++] = (value)
@@ -149,25 +286,30 @@ int currentClusterSize;
 #define STACKISEMPTY top==0
 #define STACKISNOTEMPTY top>0
 
-void identifyClusters(){
-    int i, j, top, currentVertex;
-    int stack[12];
+void initClusterStorage(){
+    visited = allocate(pentagonCount, sizeof(boolean));
+    stack = allocate(pentagonCount, sizeof(int));
+}
+
+/* Returns the number of the partition formed by the cluster sizes of a graph
+ * with n vertices. This function is inlined with a constant n for the
+ * pentagonal adjacency graphs of fullerenes, so that case gets its own
+ * specialised copy.
+ */
+static inline int identifyClustersOfOrder(int n){
+    int i, top, currentVertex;
+    PARTITIONKEY key = 0;
     
-    for(i = 0; i < 12; i++){
+    for(i = 0; i < n; i++){
         visited[i] = FALSE;
-        currentPartition[i] = 0;
     }
     
-    for(i = 0; i < 12; i++){
+    for(i = 0; i < n; i++){
         if(!visited[i]){
-            for(j = 0; j < 12; j++){
-                currentCluster[j] = FALSE;
-            }
-            
             //build cluster containing vertex i
             top = 0;
             PUSH(stack, i);
-            visited[i] = currentCluster[i] = TRUE;
+            visited[i] = TRUE;
             currentClusterSize = 1;
             while(STACKISNOTEMPTY){
                 currentVertex = POP(stack);
@@ -178,7 +320,7 @@ void identifyClusters(){
                     do {
                         if (!visited[e->end]) {
                             PUSH(stack, e->end);
-                            visited[e->end] = currentCluster[e->end] = TRUE;
+                            visited[e->end] = TRUE;
                             currentClusterSize++;
                         }
                         e = e->next;
@@ -186,28 +328,81 @@ void identifyClusters(){
                 }
             }
             
-            currentPartition[currentClusterSize-1]++;
+            key += partitionWeight[currentClusterSize-1];
         }
     }
     
-    int partitionNumber = partitions2Number[currentPartition[0]]
-                  [currentPartition[1]]
-                  [currentPartition[2]]
-                  [currentPartition[3]]
-                  [currentPartition[4]]
-                  [currentPartition[5]]
-                  [currentPartition[6]]
-                  [currentPartition[7]]
-                  [currentPartition[8]]
-                  [currentPartition[9]]
-                  [currentPartition[10]]
-                  [currentPartition[11]];
-
-    if(partitionNumber==requestedPartition){
-        fprintf(stdout, "%d ", numberOfGraphs);
-        numberOfAppearancesOfRequestedPartition++;
-    }
+    return getPartitionNumber(key);
+}
+
+/* Returns TRUE if the cluster sizes form the requested partition. */
+boolean identifyClusters(){
+    int partitionNumber;
     
+    if(nv == 12){
+        partitionNumber = identifyClustersOfOrder(12);
+    } else {
+        partitionNumber = identifyClustersOfOrder(nv);
+    }
+
+    return partitionNumber==requestedPartition;
+}
+
+void checkPentagonCount(){
+    if(nv!=pentagonCount){
+        fprintf(stderr, "Read a graph with %d vertices while expecting pentagonal adjacency graphs\n", nv);
+        fprintf(stderr, "with %d vertices (use --pentagons to change this) -- exiting!\n", pentagonCount);
+        exit(1);
+    }
+}
+
+//=============== Graph storage ===========================
+
+/* Returns storage for count elements of the given size to replace current.
+ * The contents are not preserved. The initial storage is the static array,
+ * which is never freed.
+ */
+void *resizeStorage(void *current, void *initial, size_t count, size_t size){
+    if(current != initial){
+        free(current);
+    }
+    void *storage = malloc(count * size);
+    if(storage == NULL){
+        fprintf(stderr, "Insufficient memory for the graph storage -- exiting!\n");
+        exit(1);
+    }
+    return storage;
+}
+
+/* Makes sure that graphs with n vertices fit in the graph storage. The storage
+ * grows by at least half of its size to avoid repeated resizing when the
+ * graphs grow gradually.
+ */
+void ensureCapacity(int n){
+    if(firstedge == NULL){
+        //each thread starts with its own static storage
+        firstedge = firstedgeStorage;
+        degree = degreeStorage;
+        edges = edgesStorage;
+    }
+    if(n <= maxn) return;
+    if(n < maxn + maxn/2){
+        n = maxn + maxn/2;
+    }
+    firstedge = resizeStorage(firstedge, firstedgeStorage, n, sizeof(EDGE *));
+    degree = resizeStorage(degree, degreeStorage, n, sizeof(int));
+    edges = resizeStorage(edges, edgesStorage, EDGECOUNT(n), sizeof(EDGE));
+    maxn = n;
+}
+
+void growCodeBuffer(unsigned short **code, int *capacity, int newCapacity){
+    unsigned short *buffer = realloc(*code, newCapacity * sizeof(unsigned short));
+    if(buffer == NULL){
+        fprintf(stderr, "Insufficient memory for a code of length %d -- exiting!\n", newCapacity);
+        exit(1);
+    }
+    *code = buffer;
+    *capacity = newCapacity;
 }
 
 //=============== Reading and decoding planarcode ===========================
@@ -236,6 +431,8 @@ void decodePlanarCode(unsigned short* code) {
     nv = code[0];
     codePosition = 1;
 
+    ensureCapacity(nv);
+
     for (i = 0; i < nv; i++) {
         degree[i] = 0;
         if(code[codePosition]){
@@ -280,20 +477,41 @@ void decodePlanarCode(unsigned short* code) {
     ne = edgeCounter;
 }
 
+/* Returns the next byte of a code or header. Exits if the input ends there,
+ * instead of storing EOF in the code and reading on forever.
+ */
+static inline unsigned short readCodeByte(FILE *file){
+    int c = getc(file);
+    if (c == EOF) {
+        fprintf(stderr, "The input ends in the middle of a graph -- exiting!\n");
+        exit(1);
+    }
+    return c;
+}
+
 /**
- * 
- * @param code
+ * Reads the next code into *codePointer. The buffer is (re)allocated when
+ * it is too small for the code and *codeCapacity is updated accordingly.
+ *
+ * @param codePointer
+ * @param codeCapacity
  * @param length
  * @param file
  * @return returns 1 if a code was read and 0 otherwise. Exits in case of error.
  */
-int readPlanarCode(unsigned short code[], int *length, FILE *file) {
+int readPlanarCode(unsigned short **codePointer, int *codeCapacity, int *length, FILE *file) {
     static int first = 1;
     unsigned char c;
     char testheader[20];
     int bufferSize, zeroCounter;
     
     int readCount;
+    unsigned short *code;
+
+    if (*codeCapacity < CODELENGTH(maxn)) {
+        growCodeBuffer(codePointer, codeCapacity, CODELENGTH(maxn));
+    }
+    code = *codePointer;
 
 
     if (first) {
@@ -336,16 +554,16 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
         code[0] = c;
         bufferSize = 1;
         zeroCounter = 0;
-        code[1] = (unsigned short) getc(file);
+        code[1] = readCodeByte(file);
         if (code[1] == 0) zeroCounter++;
-        code[2] = (unsigned short) getc(file);
+        code[2] = readCodeByte(file);
         if (code[2] == 0) zeroCounter++;
         bufferSize = 3;
         // 3 characters were read and stored in buffer
         if ((code[1] == '>') && (code[2] == 'p')) /*we are sure that we're dealing with a header*/ {
-            while ((c = getc(file)) != '<');
+            while ((c = readCodeByte(file)) != '<');
             /* read 2 more characters: */
-            c = getc(file);
+            c = readCodeByte(file);
             if (c != '<') {
                 fprintf(stderr, "Problems with header -- single '<'\n");
                 exit(1);
@@ -365,12 +583,16 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
 
     if (c != 0) /* unsigned chars would be sufficient */ {
         code[0] = c;
-        if (code[0] > MAXN) {
-            fprintf(stderr, "Constant N too small %d > %d \n", code[0], MAXN);
-            exit(1);
+        if (*codeCapacity < CODELENGTH(code[0])) {
+            growCodeBuffer(codePointer, codeCapacity, CODELENGTH(code[0]));
+            code = *codePointer;
         }
         while (zeroCounter < code[0]) {
-            code[bufferSize] = (unsigned short) getc(file);
+            if (bufferSize == *codeCapacity) {
+                growCodeBuffer(codePointer, codeCapacity, 2 * *codeCapacity);
+                code = *codePointer;
+            }
+            code[bufferSize] = readCodeByte(file);
             if (code[bufferSize] == 0) zeroCounter++;
             bufferSize++;
         }
@@ -380,13 +602,17 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
             fprintf(stderr, "Unexpected EOF.\n");
             exit(1);
         }
-        if (code[0] > MAXN) {
-            fprintf(stderr, "Constant N too small %d > %d \n", code[0], MAXN);
-            exit(1);
+        if (*codeCapacity < CODELENGTH(code[0])) {
+            growCodeBuffer(codePointer, codeCapacity, CODELENGTH(code[0]));
+            code = *codePointer;
         }
         bufferSize = 1;
         zeroCounter = 0;
         while (zeroCounter < code[0]) {
+            if (bufferSize == *codeCapacity) {
+                growCodeBuffer(codePointer, codeCapacity, 2 * *codeCapacity);
+                code = *codePointer;
+            }
             readCount = fread(code + bufferSize, sizeof (unsigned short), 1, file);
             if(!readCount){
                 fprintf(stderr, "Unexpected EOF.\n");
@@ -403,51 +629,166 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
 
 }
 
+//=============== Parallel analysis ===========================
+
+void initWorker(int worker){
+    initClusterStorage();
+}
+
+/* Writes the match for code i of the batch. Its original is the next code,
+ * which only exists with --original: without it, i + 2 can be past the end of
+ * codeStart.
+ */
+void writeBatchMatch(BATCH *batch, int i, int rank){
+    if(writeOriginals){
+        writeMatch(rank, batch->codes + batch->codeStart[i + 1],
+                batch->codeStart[i + 2] - batch->codeStart[i + 1]);
+    } else {
+        writeMatch(rank, NULL, 0);
+    }
+}
+
+void analyseBatch(BATCH *batch){
+    int i, step = writeOriginals ? 2 : 1, found = 0;
+    for(i = 0; i < batch->count; i += step){
+        startGraph();
+        decodePlanarCode(batch->codes + batch->codeStart[i]);
+        markStage(STAGE_DECODE);
+        checkPentagonCount();
+        if(identifyClusters()){
+            writeBatchMatch(batch, i, batch->firstGraph + i/step + 1);
+            found++;
+        }
+        markStage(STAGE_ANALYSIS);
+    }
+    //added after each batch, so that progress reports include it
+    __atomic_add_fetch(&numberOfAppearancesOfRequestedPartition, found, __ATOMIC_RELAXED);
+}
+
+PARALLELANALYSIS parallelAnalysis = {initWorker, analyseBatch, NULL};
+
 //====================== USAGE =======================
 
 void help(char *name) {
-    fprintf(stderr, "The program %s searches pentagonal adjacency graphs of\nfullerenes for ones having cluster sizes that realise a specific partition\nof 12.\n\n", name);
+    fprintf(stderr, "The program %s searches pentagonal adjacency graphs of\nfullerenes for ones having cluster sizes that realise a specific partition\nof the number of pentagons.\n\n", name);
     fprintf(stderr, "Usage\n=====\n");
-    fprintf(stderr, " %s [options]\n\n", name);
-    fprintf(stderr, "\nThis program can handle graphs up to %d vertices. Recompile if you need larger\n", MAXN);
-    fprintf(stderr, "graphs.\n\n");
+    fprintf(stderr, " %s [options] partition [file ...]\n\n", name);
+    fprintf(stderr, "\nThe graphs are read from the given files one after the other, or from\n");
+    fprintf(stderr, "standard in if no files are given.\n");
+    fprintf(stderr, "The storage for the graphs grows when larger graphs are read. Use the\n");
+    fprintf(stderr, "option --max-n to allocate it for a given number of vertices in advance.\n\n");
     fprintf(stderr, "Valid options\n=============\n");
     fprintf(stderr, "    -p, --partitions\n");
     fprintf(stderr, "       Print all possible partitions and then exits.\n");
     fprintf(stderr, "    -h, --help\n");
     fprintf(stderr, "       Print this help and return.\n");
+    fprintf(stderr, "    -P, --pentagons n\n");
+    fprintf(stderr, "       The number of pentagons in the structures, i.e., the number of vertices\n");
+    fprintf(stderr, "       in the pentagonal adjacency graphs. The default is 12 (fullerenes), use\n");
+    fprintf(stderr, "       6 for nanotube caps.\n");
+    fprintf(stderr, "    -m, --max-n n\n");
+    fprintf(stderr, "       Allocate the storage for graphs with up to n vertices at the start.\n");
+    fprintf(stderr, "    --stats[=file]\n");
+    fprintf(stderr, "       Write statistics about this run (time per stage, throughput and graph\n");
+    fprintf(stderr, "       sizes) in JSON to stderr or to the given file.\n");
+    fprintf(stderr, "    --progress seconds\n");
+    fprintf(stderr, "       Report the progress every given number of seconds. A report is also\n");
+    fprintf(stderr, "       written to stderr when the program receives SIGUSR1.\n");
+    fprintf(stderr, "    --async-input\n");
+    fprintf(stderr, "       Read the input on a separate thread, so reading and processing overlap.\n");
+    fprintf(stderr, "    -t, --threads n\n");
+    fprintf(stderr, "       Analyse the graphs on n threads. The default is 1.\n");
+    fprintf(stderr, "    -u, --unordered prefix\n");
+    fprintf(stderr, "       Do not keep the order of the input: each thread writes its output to\n");
+    fprintf(stderr, "       the file prefix.i as soon as a batch of graphs is analysed, and\n");
+    fprintf(stderr, "       prefix.manifest lists these files. The output of a batch is written\n");
+    fprintf(stderr, "       as a record with the rank of its first graph, its number of graphs and\n");
+    fprintf(stderr, "       its length, followed by the ranks (or with --original the graphs)\n");
+    fprintf(stderr, "       that match.\n");
+    fprintf(stderr, "    -o, --original\n");
+    fprintf(stderr, "       The input contains each pentagon partition followed by the original\n");
+    fprintf(stderr, "       graph, as written by pentagon_partition --original. Write the\n");
+    fprintf(stderr, "       original graphs that match in planar code instead of their ranks.\n");
 }
 
 void usage(char *name) {
-    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "Usage: %s [options] partition [file ...]\n", name);
     fprintf(stderr, "For more information type: %s -h \n\n", name);
 }
 
 int main(int argc, char *argv[]) {
 
     /*=========== commandline parsing ===========*/
-    
-    buildPartitions();
 
     int c, i;
+    boolean printPartitions = FALSE;
     char *name = argv[0];
     static struct option long_options[] = {
         {"partitions", no_argument, NULL, 'p'},
-        {"help", no_argument, NULL, 'h'}
+        {"help", no_argument, NULL, 'h'},
+        {"max-n", required_argument, NULL, 'm'},
+        {"stats", optional_argument, NULL, 'S'},
+        {"progress", required_argument, NULL, 'T'},
+        {"async-input", no_argument, NULL, 'A'},
+        {"threads", required_argument, NULL, 't'},
+        {"unordered", required_argument, NULL, 'u'},
+        {"original", no_argument, NULL, 'o'},
+        {"pentagons", required_argument, NULL, 'P'},
+        {NULL, 0, NULL, 0}
     };
     int option_index = 0;
+    int progressInterval = 0;
+    int threadCount = 1;
+    boolean asyncInput = FALSE;
 
-    while ((c = getopt_long(argc, argv, "hp", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "hpm:P:t:ou:", long_options, &option_index)) != -1) {
         switch (c) {
             case 'p':
-                for(i = 0; i < possiblePartitionCount; i++){
-                    fprintf(stderr, "partition %2d: ", i);
-                    printPartition(stderr, i, TRUE);
-                }
-                return EXIT_SUCCESS;
+                printPartitions = TRUE;
+                break;
             case 'h':
                 help(name);
                 return EXIT_SUCCESS;
+            case 'm':
+                ensureCapacity(atoi(optarg));
+                break;
+            case 'P':
+                pentagonCount = atoi(optarg);
+                if(pentagonCount < 1){
+                    fprintf(stderr, "The number of pentagons should be positive.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'S':
+                initStats(optarg);
+                break;
+            case 't':
+                threadCount = atoi(optarg);
+                if(threadCount < 1){
+                    fprintf(stderr, "The number of threads should be positive.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                asyncInput = TRUE;
+                break;
+            case 'u':
+                startUnorderedOutput(optarg);
+                break;
+            case 'o':
+                writeOriginals = TRUE;
+                parallelAnalysis.codesPerGraph = 2;
+                break;
+            case 'T':
+                progressInterval = atoi(optarg);
+                if(progressInterval < 1){
+                    fprintf(stderr, "The progress interval should be positive.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
             case '?':
                 usage(name);
                 return EXIT_FAILURE;
@@ -458,22 +799,63 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    buildPartitions();
+    
+    if(printPartitions){
+        for(i = 0; i < possiblePartitionCount; i++){
+            fprintf(stderr, "partition %2d: ", i);
+            printPartition(stderr, i, TRUE);
+        }
+        return EXIT_SUCCESS;
+    }
+    
+    initClusterStorage();
+    
     requestedPartition = atoi(argv[optind]);
     fprintf(stderr, "Looking for appearances of partition %d: ", requestedPartition);
     printPartition(stderr, requestedPartition, TRUE);
 
     /*=========== read planar graphs ===========*/
 
-    unsigned short code[MAXCODELENGTH];
-    int length;
-    while (readPlanarCode(code, &length, stdin)) {
-        decodePlanarCode(code);
-        numberOfGraphs++;
-        identifyClusters();
+    startProgress(&numberOfGraphs, progressInterval, reportAppearanceCount);
+    FILE *input = optind + 1 < argc ?
+            openInputFiles(argv + optind + 1, argc - (optind + 1), asyncInput) : openInput(0, asyncInput);
+
+    if(writeOriginals && unorderedPrefix == NULL){
+        writeString(">>planar_code<<");
+    }
+    if(threadCount > 1 || unorderedPrefix != NULL){
+        analyseInParallel(input, threadCount, &parallelAnalysis, &numberOfGraphs);
+    } else {
+        unsigned short *code = NULL, *original = NULL;
+        int codeCapacity = 0, originalCapacity = 0;
+        int length, originalLength = 0;
+        startGraph();
+        while (readPlanarCode(&code, &codeCapacity, &length, input)) {
+            if(writeOriginals && !readPlanarCode(&original, &originalCapacity, &originalLength, input)){
+                fprintf(stderr, "The input ends in the middle of a graph -- exiting!\n");
+                exit(1);
+            }
+            markStage(STAGE_READ);
+            decodePlanarCode(code);
+            recordGraph(nv, ne, length);
+            markStage(STAGE_DECODE);
+            checkPentagonCount();
+            numberOfGraphs++;
+            if(identifyClusters()){
+                writeMatch(numberOfGraphs, original, originalLength);
+                numberOfAppearancesOfRequestedPartition++;
+            }
+            markStage(STAGE_ANALYSIS);
+            startGraph();
+        }
     }
-    if(numberOfAppearancesOfRequestedPartition){
-        fprintf(stdout, "\n");
+    startSection();
+    if(numberOfAppearancesOfRequestedPartition && !writeOriginals && unorderedPrefix == NULL){
+        writeByte('\n');
     }
+    flushOutput();
+    markStage(STAGE_OUTPUT);
     
     fprintf(stderr, "Read %d graph%s.\n", numberOfGraphs, 
                 numberOfGraphs==1 ? "" : "s");
@@ -481,6 +863,7 @@ int main(int argc, char *argv[]) {
             numberOfAppearancesOfRequestedPartition, 
             numberOfAppearancesOfRequestedPartition==1 ? "" : "s",
             requestedPartition);
+    finishStats();
     
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,162 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "bench.h"
+
+#define HEADERLENGTH 15 /* the length of ">>planar_code<<" */
+
+int benchmarkRounds = 10;
+int benchmarkGraphs = 100000;
+unsigned long long benchmarkSeed = 0x5EED;
+
+void parseBenchmarkOptions(int argc, char *argv[]){
+    int c;
+    static struct option long_options[] = {
+        {"rounds", required_argument, NULL, 'r'},
+        {"graphs", required_argument, NULL, 'g'},
+        {"seed", required_argument, NULL, 's'},
+        {NULL, 0, NULL, 0}
+    };
+    int option_index = 0;
+
+    while ((c = getopt_long(argc, argv, "r:g:s:", long_options, &option_index)) != -1) {
+        switch (c) {
+            case 'r':
+                benchmarkRounds = atoi(optarg);
+                if(benchmarkRounds < 1 || benchmarkRounds > MAXROUNDS){
+                    fprintf(stderr, "The number of rounds should be between 1 and %d.\n", MAXROUNDS);
+                    exit(1);
+                }
+                break;
+            case 'g':
+                benchmarkGraphs = atoi(optarg);
+                if(benchmarkGraphs < 1){
+                    fprintf(stderr, "The number of graphs should be positive.\n");
+                    exit(1);
+                }
+                break;
+            case 's':
+                benchmarkSeed = strtoull(optarg, NULL, 0);
+                if(benchmarkSeed == 0){
+                    fprintf(stderr, "The seed should be non-zero.\n");
+                    exit(1);
+                }
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-r rounds] [-g graphs] [-s seed]\n", argv[0]);
+                exit(1);
+        }
+    }
+}
+
+unsigned long long currentTime(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+FILE *openCorpus(CORPUS *corpus){
+    static int first = 1;
+    FILE *stream;
+
+    if(first){
+        first = 0;
+        stream = fmemopen(corpus->data, corpus->length, "r");
+    } else {
+        stream = fmemopen(corpus->data + HEADERLENGTH, corpus->length - HEADERLENGTH, "r");
+    }
+    if(stream == NULL){
+        fprintf(stderr, "Could not open the corpus -- exiting!\n");
+        exit(1);
+    }
+    return stream;
+}
+
+unsigned short *loadCodes(CORPUS *corpus, int **codeStart){
+    unsigned short *code = NULL;
+    int codeCapacity = 0;
+    int length, i = 0;
+    size_t position = 0, capacity = corpus->length;
+    unsigned short *codes = malloc(capacity * sizeof(unsigned short));
+
+    *codeStart = malloc(corpus->graphCount * sizeof(int));
+    if(codes == NULL || *codeStart == NULL){
+        fprintf(stderr, "Insufficient memory for the codes -- exiting!\n");
+        exit(1);
+    }
+
+    //every code is shorter than its encoding in the corpus
+    FILE *stream = openCorpus(corpus);
+    while(readPlanarCode(&code, &codeCapacity, &length, stream)){
+        memcpy(codes + position, code, length * sizeof(unsigned short));
+        (*codeStart)[i++] = position;
+        position += length;
+    }
+    fclose(stream);
+    free(code);
+
+    return codes;
+}
+
+#ifdef HAVE_ZSTD
+int writeZstdCorpus(CORPUS *corpus, size_t frameSize){
+    size_t position;
+    void *frame = malloc(ZSTD_compressBound(frameSize));
+    FILE *f = tmpfile();
+
+    if(frame == NULL || f == NULL){
+        fprintf(stderr, "Could not compress the corpus -- exiting!\n");
+        exit(1);
+    }
+    for(position = HEADERLENGTH; position < corpus->length; position += frameSize){
+        size_t size = corpus->length - position < frameSize ? corpus->length - position : frameSize;
+        size_t length = ZSTD_compress(frame, ZSTD_compressBound(frameSize), corpus->data + position, size, 3);
+        if(ZSTD_isError(length) || fwrite(frame, 1, length, f) != length){
+            fprintf(stderr, "Could not compress the corpus -- exiting!\n");
+            exit(1);
+        }
+    }
+    fflush(f);
+    free(frame);
+    return fileno(f);
+}
+#endif
+
+void reportBenchmark(const char *name, const char *corpusName,
+        long long graphsPerRound, unsigned long long *elapsed){
+    double sum = 0, squares = 0, min = INFINITY, max = 0;
+    int i;
+
+    for(i = 0; i < benchmarkRounds; i++){
+        double ns = (double)elapsed[i] / graphsPerRound;
+        sum += ns;
+        squares += ns * ns;
+        if(ns < min) min = ns;
+        if(ns > max) max = ns;
+    }
+    double mean = sum / benchmarkRounds;
+    double variance = benchmarkRounds > 1 ?
+            (squares - sum * mean) / (benchmarkRounds - 1) : 0;
+    if(variance < 0) variance = 0;
+
+    printf("{\"benchmark\": \"%s\", \"corpus\": \"%s\", \"graphs\": %lld, "
+            "\"rounds\": %d, \"ns_per_graph\": {\"mean\": %.2f, \"stddev\": %.2f, "
+            "\"min\": %.2f, \"max\": %.2f}, \"graphs_per_second\": %.0f}\n",
+            name, corpusName, graphsPerRound, benchmarkRounds,
+            mean, sqrt(variance), min, max, 1e9 / mean);
+    fflush(stdout);
+}
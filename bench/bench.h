@@ -0,0 +1,69 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+/* Shared code for the microbenchmarks. Each benchmark includes the source of
+ * one of the programs (with its main renamed) and times the hot functions of
+ * that program on the synthetic corpora from corpus.h.
+ *
+ * Every benchmark is run for a number of rounds and reports one JSON object
+ * per line on standard out with the mean, standard deviation, minimum and
+ * maximum of the time per graph over these rounds.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+
+#include "../corpus.h"
+
+#define MAXROUNDS 1000
+
+/* The number of times a function is repeated on each decoded graph, so the
+ * timer overhead does not dominate for fast functions.
+ */
+#define REPEATS 8
+
+extern int benchmarkRounds;
+extern int benchmarkGraphs;
+extern unsigned long long benchmarkSeed;
+
+/* Parses the options that are common to all benchmarks. Exits on error. */
+void parseBenchmarkOptions(int argc, char *argv[]);
+
+/* Returns the value of the monotonic clock in nanoseconds. */
+unsigned long long currentTime();
+
+/* Returns a stream that reads the corpus. The header is only included the
+ * first time, because readPlanarCode only expects it once.
+ */
+FILE *openCorpus(CORPUS *corpus);
+
+/* Reads all codes in the corpus into memory. The codes are stored one after
+ * the other, each at offset codeStart[i].
+ */
+unsigned short *loadCodes(CORPUS *corpus, int **codeStart);
+
+#ifdef HAVE_ZSTD
+/* Writes the corpus without its header to a temporary file, compressed as
+ * separate zstd frames of at most frameSize bytes of planar code, and returns
+ * its descriptor.
+ */
+int writeZstdCorpus(CORPUS *corpus, size_t frameSize);
+#endif
+
+/* Writes the statistics for a benchmark in which each round processed the
+ * given number of graphs. elapsed contains the duration of each round in
+ * nanoseconds.
+ */
+void reportBenchmark(const char *name, const char *corpusName,
+        long long graphsPerRound, unsigned long long *elapsed);
+
+/* Provided by the program that is benchmarked. */
+int readPlanarCode(unsigned short **codePointer, int *codeCapacity, int *length, FILE *file);
+
+#endif /* BENCH_H */
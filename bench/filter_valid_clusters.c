@@ -0,0 +1,55 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+/* Benchmarks hasValidClusters from filter_valid_clusters on a corpus of
+ * pentagonal adjacency graphs.
+ */
+
+#define main filter_valid_clusters_main
+#include "../filter_valid_clusters.c"
+#undef main
+
+#include "bench.h"
+
+int main(int argc, char *argv[]) {
+    unsigned long long elapsed[MAXROUNDS];
+    unsigned long long start;
+    int round, i, k;
+    CORPUS corpus;
+
+    parseBenchmarkOptions(argc, argv);
+
+    initCorpus(&corpus);
+    addPentagonGraphs(&corpus, benchmarkGraphs, &benchmarkSeed);
+
+    buildPartitionTable();
+    buildDegreeSumBounds();
+    initClusterStorage();
+
+    int *codeStart;
+    unsigned short *codes = loadCodes(&corpus, &codeStart);
+
+    for(round = 0; round < benchmarkRounds; round++){
+        elapsed[round] = 0;
+        for(i = 0; i < benchmarkGraphs; i++){
+            decodePlanarCode(codes + codeStart[i]);
+            start = currentTime();
+            for(k = 0; k < REPEATS; k++){
+                hasValidClusters();
+            }
+            elapsed[round] += currentTime() - start;
+        }
+    }
+    reportBenchmark("hasValidClusters", "pentagon_graphs",
+            (long long)benchmarkGraphs * REPEATS, elapsed);
+
+    free(codes);
+    free(codeStart);
+    freeCorpus(&corpus);
+
+    return EXIT_SUCCESS;
+}
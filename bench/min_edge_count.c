@@ -0,0 +1,54 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+/* Benchmarks countEdges from min_edge_count on a corpus of pentagonal
+ * adjacency graphs.
+ */
+
+#define main min_edge_count_main
+#include "../min_edge_count.c"
+#undef main
+
+#include "bench.h"
+
+int main(int argc, char *argv[]) {
+    unsigned long long elapsed[MAXROUNDS];
+    unsigned long long start;
+    int round, i, k;
+    CORPUS corpus;
+
+    parseBenchmarkOptions(argc, argv);
+
+    initCorpus(&corpus);
+    addPentagonGraphs(&corpus, benchmarkGraphs, &benchmarkSeed);
+
+    int *codeStart;
+    unsigned short *codes = loadCodes(&corpus, &codeStart);
+
+    for(round = 0; round < benchmarkRounds; round++){
+        elapsed[round] = 0;
+        for(i = 0; i < benchmarkGraphs; i++){
+            decodePlanarCode(codes + codeStart[i]);
+            //keep the list of graphs with the minimum number of edges short
+            minEdgeCount = INT_MAX;
+            minEdgeNumberCount = 0;
+            start = currentTime();
+            for(k = 0; k < REPEATS; k++){
+                countEdges();
+            }
+            elapsed[round] += currentTime() - start;
+        }
+    }
+    reportBenchmark("countEdges", "pentagon_graphs",
+            (long long)benchmarkGraphs * REPEATS, elapsed);
+
+    free(codes);
+    free(codeStart);
+    freeCorpus(&corpus);
+
+    return EXIT_SUCCESS;
+}
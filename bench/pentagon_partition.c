@@ -0,0 +1,126 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+/* Benchmarks readPlanarCode, decodePlanarCode, makeDual and
+ * writePentagonPartitionPlanarCode from pentagon_partition on a corpus of
+ * fullerenes. The output is discarded.
+ *
+ * When compiled with HAVE_ZSTD, readPlanarCode is also timed on the corpus
+ * compressed as several zstd frames, which the input layer decompresses in
+ * parallel. The codes that are read are checked against the plain corpus.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#define main pentagon_partition_main
+#include "../pentagon_partition.c"
+#undef main
+
+#include "bench.h"
+
+#define ZSTDFRAMESIZE (1<<16) /* the size of the frames of the compressed corpus */
+
+int main(int argc, char *argv[]) {
+    unsigned long long elapsed[MAXROUNDS];
+    unsigned long long start;
+    int round, i, k;
+    CORPUS corpus;
+
+    parseBenchmarkOptions(argc, argv);
+    int graphs = benchmarkGraphs / 10;
+    if(graphs < 1) graphs = 1;
+
+    initCorpus(&corpus);
+    addFullerenes(&corpus, graphs, &benchmarkSeed);
+
+    outputBuffer.fd = open("/dev/null", O_WRONLY);
+    if(outputBuffer.fd < 0){
+        fprintf(stderr, "Could not open /dev/null -- exiting!\n");
+        return EXIT_FAILURE;
+    }
+
+    unsigned short *code = NULL;
+    int codeCapacity = 0;
+    int length;
+    for(round = 0; round < benchmarkRounds; round++){
+        FILE *stream = openCorpus(&corpus);
+        start = currentTime();
+        while(readPlanarCode(&code, &codeCapacity, &length, stream));
+        elapsed[round] = currentTime() - start;
+        fclose(stream);
+    }
+    reportBenchmark("readPlanarCode", "fullerenes", graphs, elapsed);
+
+    int *codeStart;
+    unsigned short *codes = loadCodes(&corpus, &codeStart);
+
+    for(round = 0; round < benchmarkRounds; round++){
+        start = currentTime();
+        for(i = 0; i < graphs; i++){
+            decodePlanarCode(codes + codeStart[i]);
+        }
+        elapsed[round] = currentTime() - start;
+    }
+    reportBenchmark("decodePlanarCode", "fullerenes", graphs, elapsed);
+
+#ifdef HAVE_ZSTD
+    int zstdFd = writeZstdCorpus(&corpus, ZSTDFRAMESIZE);
+    for(round = 0; round < benchmarkRounds; round++){
+        lseek(zstdFd, 0, SEEK_SET);
+        FILE *stream = openInput(zstdFd, 0);
+        start = currentTime();
+        for(i = 0; readPlanarCode(&code, &codeCapacity, &length, stream); i++){
+            if(i == graphs || memcmp(code, codes + codeStart[i], length * sizeof(unsigned short))){
+                break;
+            }
+        }
+        elapsed[round] = currentTime() - start;
+        if(i != graphs){
+            fprintf(stderr, "Graph %d of the zstd corpus differs from the plain corpus -- exiting!\n", i + 1);
+            return EXIT_FAILURE;
+        }
+        fclose(stream);
+    }
+    reportBenchmark("readPlanarCode", "fullerenes_zstd_frames", graphs, elapsed);
+#endif
+
+    for(round = 0; round < benchmarkRounds; round++){
+        elapsed[round] = 0;
+        for(i = 0; i < graphs; i++){
+            decodePlanarCode(codes + codeStart[i]);
+            start = currentTime();
+            for(k = 0; k < REPEATS; k++){
+                makeDual();
+            }
+            elapsed[round] += currentTime() - start;
+        }
+    }
+    reportBenchmark("makeDual", "fullerenes", (long long)graphs * REPEATS, elapsed);
+
+    for(round = 0; round < benchmarkRounds; round++){
+        elapsed[round] = 0;
+        for(i = 0; i < graphs; i++){
+            decodePlanarCode(codes + codeStart[i]);
+            start = currentTime();
+            for(k = 0; k < REPEATS; k++){
+                writePentagonPartitionPlanarCode();
+            }
+            elapsed[round] += currentTime() - start;
+        }
+    }
+    flushOutput();
+    reportBenchmark("writePentagonPartitionPlanarCode", "fullerenes",
+            (long long)graphs * REPEATS, elapsed);
+
+    free(codes);
+    free(codeStart);
+    free(code);
+    freeCorpus(&corpus);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,312 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+#include "output.h"
+
+#define CACHEMAGIC "PCCACHE1"
+#define HASHBUFFERSIZE (1<<20)
+
+//=============== XXH64 ===========================
+
+#define PRIME1 11400714785074694791ULL
+#define PRIME2 14029467366897019727ULL
+#define PRIME3 1609587929392839161ULL
+#define PRIME4 9650029242287828579ULL
+#define PRIME5 2870177450012600261ULL
+
+typedef struct {
+    unsigned long long total; /* the number of bytes hashed so far */
+    unsigned long long lanes[4];
+    unsigned char pending[32]; /* the bytes that do not fill a stripe yet */
+    int pendingLength;
+    unsigned long long seed;
+} HASHSTATE;
+
+static inline unsigned long long rotateLeft(unsigned long long x, int r){
+    return (x << r) | (x >> (64 - r));
+}
+
+/* Reads 8 and 4 bytes in little endian byte order (the byte order of the
+ * machines on which the programs are used).
+ */
+static inline unsigned long long read64(const unsigned char *p){
+    unsigned long long value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline unsigned long long read32(const unsigned char *p){
+    unsigned int value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline unsigned long long hashRound(unsigned long long lane, unsigned long long input){
+    lane += input * PRIME2;
+    return rotateLeft(lane, 31) * PRIME1;
+}
+
+static inline unsigned long long mergeRound(unsigned long long hash, unsigned long long lane){
+    hash ^= hashRound(0, lane);
+    return hash * PRIME1 + PRIME4;
+}
+
+static void initHash(HASHSTATE *state, unsigned long long seed){
+    state->total = 0;
+    state->lanes[0] = seed + PRIME1 + PRIME2;
+    state->lanes[1] = seed + PRIME2;
+    state->lanes[2] = seed;
+    state->lanes[3] = seed - PRIME1;
+    state->pendingLength = 0;
+    state->seed = seed;
+}
+
+static inline void hashStripe(HASHSTATE *state, const unsigned char *p){
+    state->lanes[0] = hashRound(state->lanes[0], read64(p));
+    state->lanes[1] = hashRound(state->lanes[1], read64(p + 8));
+    state->lanes[2] = hashRound(state->lanes[2], read64(p + 16));
+    state->lanes[3] = hashRound(state->lanes[3], read64(p + 24));
+}
+
+static void updateHash(HASHSTATE *state, const void *data, size_t length){
+    const unsigned char *p = data;
+    const unsigned char *end = p + length;
+
+    state->total += length;
+    if(state->pendingLength + length < 32){
+        memcpy(state->pending + state->pendingLength, p, length);
+        state->pendingLength += length;
+        return;
+    }
+    if(state->pendingLength){
+        memcpy(state->pending + state->pendingLength, p, 32 - state->pendingLength);
+        p += 32 - state->pendingLength;
+        hashStripe(state, state->pending);
+        state->pendingLength = 0;
+    }
+    while(p + 32 <= end){
+        hashStripe(state, p);
+        p += 32;
+    }
+    memcpy(state->pending, p, end - p);
+    state->pendingLength = end - p;
+}
+
+static unsigned long long digestHash(HASHSTATE *state){
+    unsigned long long hash;
+    const unsigned char *p = state->pending;
+    const unsigned char *end = p + state->pendingLength;
+    int i;
+
+    if(state->total >= 32){
+        hash = rotateLeft(state->lanes[0], 1) + rotateLeft(state->lanes[1], 7) +
+                rotateLeft(state->lanes[2], 12) + rotateLeft(state->lanes[3], 18);
+        for(i = 0; i < 4; i++){
+            hash = mergeRound(hash, state->lanes[i]);
+        }
+    } else {
+        hash = state->seed + PRIME5;
+    }
+    hash += state->total;
+
+    for(; p + 8 <= end; p += 8){
+        hash ^= hashRound(0, read64(p));
+        hash = rotateLeft(hash, 27) * PRIME1 + PRIME4;
+    }
+    if(p + 4 <= end){
+        hash ^= read32(p) * PRIME1;
+        hash = rotateLeft(hash, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    for(; p < end; p++){
+        hash ^= *p * PRIME5;
+        hash = rotateLeft(hash, 11) * PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+//=============== Cache entries ===========================
+
+static int cacheEnabled = 0;
+static char *entryName = NULL;
+static BYTEBUFFER cachedOutput;
+static BYTEBUFFER cachedSummary;
+
+/* Adds the contents of fd from its current offset and their length to the
+ * hash. The offset of fd does not change. Returns 0 if fd is not a regular
+ * file.
+ */
+static int hashFile(HASHSTATE *state, int fd, const char *name, unsigned char *buffer){
+    struct stat status;
+    if(fstat(fd, &status) || !S_ISREG(status.st_mode)){
+        return 0;
+    }
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    unsigned long long length = 0;
+    ssize_t count;
+    while((count = pread(fd, buffer, HASHBUFFERSIZE, offset + length)) != 0){
+        if(count < 0){
+            if(errno == EINTR) continue;
+            fprintf(stderr, "Could not read %s -- exiting!\n", name);
+            exit(1);
+        }
+        updateHash(state, buffer, count);
+        length += count;
+    }
+    updateHash(state, &length, sizeof(length));
+    return 1;
+}
+
+/* Writes an entry that was read from the cache. Returns 0 if it is not a
+ * valid entry.
+ */
+static int replayEntry(unsigned char *entry, size_t length){
+    unsigned int summaryLength;
+    size_t headerLength = strlen(CACHEMAGIC) + sizeof(summaryLength);
+    if(length < headerLength || memcmp(entry, CACHEMAGIC, strlen(CACHEMAGIC))){
+        return 0;
+    }
+    memcpy(&summaryLength, entry + strlen(CACHEMAGIC), sizeof(summaryLength));
+    if(summaryLength > length - headerLength){
+        return 0;
+    }
+    writeBytes(entry + headerLength + summaryLength, length - headerLength - summaryLength);
+    flushOutput();
+    fwrite(entry + headerLength, 1, summaryLength, stderr);
+    return 1;
+}
+
+int lookupCachedResult(const char *directory, const char *settings, char **files, int fileCount){
+    HASHSTATE state;
+    unsigned char *buffer = malloc(HASHBUFFERSIZE);
+    int i, cacheable = 1;
+
+    if(buffer == NULL){
+        fprintf(stderr, "Insufficient memory for the cache -- exiting!\n");
+        exit(1);
+    }
+    initHash(&state, 0);
+    updateHash(&state, settings, strlen(settings) + 1);
+    if(fileCount == 0){
+        cacheable = hashFile(&state, 0, "standard in", buffer);
+    }
+    for(i = 0; i < fileCount && cacheable; i++){
+        int fd = open(files[i], O_RDONLY);
+        if(fd < 0){
+            fprintf(stderr, "Could not open %s -- exiting!\n", files[i]);
+            exit(1);
+        }
+        cacheable = hashFile(&state, fd, files[i], buffer);
+        close(fd);
+    }
+    free(buffer);
+    if(!cacheable){
+        fprintf(stderr, "The input is not read from regular files, so the cache is not used.\n");
+        return 0;
+    }
+
+    entryName = malloc(strlen(directory) + 18);
+    if(entryName == NULL){
+        fprintf(stderr, "Insufficient memory for the cache -- exiting!\n");
+        exit(1);
+    }
+    sprintf(entryName, "%s/%016llx", directory, digestHash(&state));
+
+    FILE *f = fopen(entryName, "r");
+    if(f != NULL){
+        BYTEBUFFER entry = {NULL, 0, 0};
+        unsigned char block[1<<16];
+        size_t count;
+        while((count = fread(block, 1, sizeof(block), f)) > 0){
+            appendBytes(&entry, block, count);
+        }
+        int valid = !ferror(f) && replayEntry(entry.data, entry.length);
+        fclose(f);
+        free(entry.data);
+        if(valid){
+            return 1;
+        }
+        fprintf(stderr, "Ignoring the invalid cache entry %s.\n", entryName);
+    }
+
+    if(mkdir(directory, 0755) && errno != EEXIST){
+        fprintf(stderr, "Could not create the cache directory %s, so the cache is not used.\n", directory);
+        return 0;
+    }
+    cacheEnabled = 1;
+    flushOutput();
+    outputBuffer.capture = &cachedOutput;
+    return 0;
+}
+
+void writeSummary(const char *format, ...){
+    va_list arguments;
+    va_start(arguments, format);
+    if(cacheEnabled){
+        char line[1024];
+        va_list copy;
+        va_copy(copy, arguments);
+        int length = vsnprintf(line, sizeof(line), format, copy);
+        va_end(copy);
+        if(length > 0){
+            appendBytes(&cachedSummary, line, length < (int)sizeof(line) ? length : (int)sizeof(line) - 1);
+        }
+    }
+    vfprintf(stderr, format, arguments);
+    va_end(arguments);
+}
+
+void storeCachedResult(){
+    if(!cacheEnabled){
+        return;
+    }
+    flushOutput();
+    outputBuffer.capture = NULL;
+    writeBytes(cachedOutput.data, cachedOutput.length);
+    flushOutput();
+
+    //the entry is renamed when it is complete, so an interrupted run leaves no entry
+    char *temporaryName = malloc(strlen(entryName) + 32);
+    if(temporaryName == NULL){
+        fprintf(stderr, "Insufficient memory for the cache -- exiting!\n");
+        exit(1);
+    }
+    sprintf(temporaryName, "%s.%d.tmp", entryName, (int)getpid());
+    unsigned int summaryLength = cachedSummary.length;
+    FILE *f = fopen(temporaryName, "w");
+    int failed = f == NULL;
+    if(!failed){
+        fwrite(CACHEMAGIC, 1, strlen(CACHEMAGIC), f);
+        fwrite(&summaryLength, sizeof(summaryLength), 1, f);
+        fwrite(cachedSummary.data, 1, cachedSummary.length, f);
+        fwrite(cachedOutput.data, 1, cachedOutput.length, f);
+        failed = ferror(f);
+        failed |= fclose(f) != 0;
+    }
+    if(failed || rename(temporaryName, entryName)){
+        fprintf(stderr, "Could not write the cache entry %s.\n", entryName);
+        unlink(temporaryName);
+    }
+    free(temporaryName);
+    cacheEnabled = 0;
+}
@@ -0,0 +1,40 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+/* A cache for the results of complete runs. The key of a run is a 64-bit
+ * XXH64 hash of the settings of the program and of the contents of its input
+ * files, so a run on the same input with the same settings writes the stored
+ * output instead of reading the graphs again. Each entry is a file in the
+ * cache directory, named after the key, that holds the summary written to
+ * stderr and the output written to standard out.
+ *
+ * The input is hashed before it is read, so the cache can only be used when
+ * all input is read from regular files (not from a pipe).
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#define DEFAULTCACHEDIRECTORY ".cluster_cache"
+
+/* Computes the key of this run from settings and the input files (or standard
+ * in if fileCount is 0). If the cache directory contains an entry for this key,
+ * its output and summary are written and TRUE is returned. Otherwise the
+ * output of the main thread is kept until storeCachedResult is called, and
+ * FALSE is returned.
+ */
+int lookupCachedResult(const char *directory, const char *settings, char **files, int fileCount);
+
+/* Writes a line of the summary to stderr, and keeps it for the cache. */
+void writeSummary(const char *format, ...);
+
+/* Writes the output and stores it with the summary in the cache. Does nothing
+ * if lookupCachedResult was not called or the input cannot be cached.
+ */
+void storeCachedResult();
+
+#endif /* CACHE_H */
@@ -0,0 +1,565 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+/* This program answers questions about the cluster sizes of many graphs
+ * without reading the graphs again. It memory-maps the partition indexes
+ * written by count_all_clusters --partition-index (one per number of vertices
+ * n of the fullerenes) and answers queries on a Unix socket. The partitions
+ * are numbered as in count_all_clusters and appearances_of_clusters.
+ *
+ * A query is a single line and the answer ends with a line containing a single
+ * dot. The queries are:
+ *
+ *     partitions                      the partitions with their numbers
+ *     count n[-m] [selector]          the number of graphs per partition, or
+ *                                     of the graphs that match the selector
+ *     ranks n selector [limit]        the ranks of the graphs that match
+ *
+ * A selector is a list of conditions separated by commas, which must all hold:
+ * a partition number, has=k (a cluster of size k), max>=k or max<=k (for the
+ * largest cluster) and clusters=k (the number of clusters). Ranks start from 1.
+ *
+ *
+ * Compile with:
+ *
+ *     cc -o cluster_server -O4 cluster_server.c
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <getopt.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define FALSE 0
+#define TRUE  1
+
+typedef int boolean;
+
+#define PARTITIONINDEXMAGIC "PARTIDX1"
+#define MAXQUERYLENGTH 1024
+
+/* The header of a partition index, see count_all_clusters. */
+typedef struct {
+    char magic[8];
+    unsigned int pentagonCount;
+    unsigned int entrySize; /* the number of bytes per graph: 1 or 2 */
+} PARTITIONINDEXHEADER;
+
+typedef struct {
+    int n; /* the number of vertices of the fullerenes */
+    const char *fileName;
+    const unsigned char *entries; /* the partition number of each graph */
+    unsigned long long graphCount;
+    int entrySize;
+    unsigned long long *partitionCount; /* computed when the index is loaded */
+} PARTITIONINDEX;
+
+PARTITIONINDEX *indexes;
+int indexCount = 0;
+
+int pentagonCount = 0;
+
+//=============== Partitions ===========================
+
+/* The partitions are built in the same order as in count_all_clusters, so the
+ * numbers are the same. possiblePartitions[i*pentagonCount + s - 1] is the
+ * number of clusters of size s in partition i.
+ */
+int *possiblePartitions;
+int possiblePartitionCount;
+int possiblePartitionCapacity;
+int *currentPossiblePartition;
+
+void *allocate(size_t count, size_t size){
+    void *storage = calloc(count, size);
+    if(storage == NULL){
+        fprintf(stderr, "Insufficient memory -- exiting!\n");
+        exit(1);
+    }
+    return storage;
+}
+
+void storePossiblePartition(){
+    int i;
+    if(possiblePartitionCount == possiblePartitionCapacity){
+        possiblePartitionCapacity *= 2;
+        possiblePartitions = realloc(possiblePartitions,
+                possiblePartitionCapacity * pentagonCount * sizeof(int));
+        if(possiblePartitions == NULL){
+            fprintf(stderr, "Insufficient memory for the partition tables -- exiting!\n");
+            exit(1);
+        }
+    }
+    for(i=0; i<pentagonCount; i++){
+        possiblePartitions[possiblePartitionCount*pentagonCount + i] = currentPossiblePartition[i];
+    }
+    possiblePartitionCount++;
+}
+
+void buildPartitions_recursive(int currentSize, int sum){
+    if(sum==pentagonCount){
+        storePossiblePartition();
+        return;
+    }
+    if(sum + currentSize <= pentagonCount){
+        currentPossiblePartition[currentSize-1]++;
+        buildPartitions_recursive(currentSize, sum + currentSize);
+        currentPossiblePartition[currentSize-1]--;
+    }
+    if(currentSize > 1){
+        buildPartitions_recursive(currentSize-1, sum);
+    }
+}
+
+void buildPartitions(){
+    currentPossiblePartition = allocate(pentagonCount, sizeof(int));
+    possiblePartitionCapacity = 64;
+    possiblePartitions = allocate(possiblePartitionCapacity * pentagonCount, sizeof(int));
+    possiblePartitionCount = 0;
+    buildPartitions_recursive(pentagonCount, 0);
+}
+
+void printPartition(FILE *f, int part){
+    int i, j;
+    for(i = pentagonCount - 1; i >= 0; i--){
+        for(j = 0; j < possiblePartitions[part*pentagonCount + i]; j++){
+            fprintf(f, "%d ", i+1);
+        }
+    }
+    fprintf(f, "\n");
+}
+
+int largestCluster(int part){
+    int s = pentagonCount;
+    while(possiblePartitions[part*pentagonCount + s - 1] == 0){
+        s--;
+    }
+    return s;
+}
+
+int clusterCount(int part){
+    int s, count = 0;
+    for(s = 1; s <= pentagonCount; s++){
+        count += possiblePartitions[part*pentagonCount + s - 1];
+    }
+    return count;
+}
+
+//=============== Loading the indexes ===========================
+
+static inline int entry(PARTITIONINDEX *index, unsigned long long graph){
+    if(index->entrySize == 1){
+        return index->entries[graph];
+    }
+    return index->entries[2*graph] | index->entries[2*graph + 1] << 8;
+}
+
+/* Loads an index given as n=file. */
+void loadIndex(PARTITIONINDEX *index, char *argument){
+    char *separator = strchr(argument, '=');
+    struct stat status;
+    PARTITIONINDEXHEADER header;
+    unsigned long long graph;
+
+    if(separator == NULL || (index->n = atoi(argument)) <= 0){
+        fprintf(stderr, "An index should be given as n=file, not as %s -- exiting!\n", argument);
+        exit(1);
+    }
+    index->fileName = separator + 1;
+    int fd = open(index->fileName, O_RDONLY);
+    if(fd < 0 || fstat(fd, &status)){
+        fprintf(stderr, "Could not open %s -- exiting!\n", index->fileName);
+        exit(1);
+    }
+    if(status.st_size < (off_t)sizeof(PARTITIONINDEXHEADER) ||
+            read(fd, &header, sizeof(PARTITIONINDEXHEADER)) != sizeof(PARTITIONINDEXHEADER) ||
+            memcmp(header.magic, PARTITIONINDEXMAGIC, sizeof(header.magic)) ||
+            (header.entrySize != 1 && header.entrySize != 2) ||
+            (status.st_size - sizeof(PARTITIONINDEXHEADER)) % header.entrySize){
+        fprintf(stderr, "%s is not a partition index -- exiting!\n", index->fileName);
+        exit(1);
+    }
+    if(pentagonCount == 0){
+        pentagonCount = header.pentagonCount;
+        buildPartitions();
+    } else if(header.pentagonCount != pentagonCount){
+        fprintf(stderr, "The index %s is for %d pentagons instead of %d -- exiting!\n",
+                index->fileName, header.pentagonCount, pentagonCount);
+        exit(1);
+    }
+    index->entrySize = header.entrySize;
+    index->graphCount = (status.st_size - sizeof(PARTITIONINDEXHEADER)) / header.entrySize;
+
+    const unsigned char *map = NULL;
+    if(index->graphCount){
+        map = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if(map == MAP_FAILED){
+            fprintf(stderr, "Could not map %s -- exiting!\n", index->fileName);
+            exit(1);
+        }
+        madvise((void *)map, status.st_size, MADV_WILLNEED);
+    }
+    close(fd);
+    index->entries = map == NULL ? NULL : map + sizeof(PARTITIONINDEXHEADER);
+
+    index->partitionCount = allocate(possiblePartitionCount, sizeof(unsigned long long));
+    for(graph = 0; graph < index->graphCount; graph++){
+        int part = entry(index, graph);
+        if(part >= possiblePartitionCount){
+            fprintf(stderr, "%s contains an invalid partition number -- exiting!\n", index->fileName);
+            exit(1);
+        }
+        index->partitionCount[part]++;
+    }
+}
+
+int compareIndexes(const void *a, const void *b){
+    return ((PARTITIONINDEX *)a)->n - ((PARTITIONINDEX *)b)->n;
+}
+
+PARTITIONINDEX *findIndex(int n){
+    PARTITIONINDEX key = {n};
+    return bsearch(&key, indexes, indexCount, sizeof(PARTITIONINDEX), compareIndexes);
+}
+
+//=============== Answering queries ===========================
+
+/* Parses a selector into selected, which tells for each partition whether it
+ * matches. Returns FALSE if the selector is not valid.
+ */
+boolean parseSelector(char *selector, boolean *selected){
+    int part;
+    char *condition;
+
+    for(part = 0; part < possiblePartitionCount; part++){
+        selected[part] = TRUE;
+    }
+    for(condition = strtok(selector, ","); condition != NULL; condition = strtok(NULL, ",")){
+        int k;
+        char *end;
+        if(!strncmp(condition, "has=", 4)){
+            k = strtol(condition + 4, &end, 10);
+            if(*end || k < 1 || k > pentagonCount) return FALSE;
+            for(part = 0; part < possiblePartitionCount; part++){
+                selected[part] &= possiblePartitions[part*pentagonCount + k - 1] > 0;
+            }
+        } else if(!strncmp(condition, "max>=", 5) || !strncmp(condition, "max<=", 5)){
+            boolean atLeast = condition[3] == '>';
+            k = strtol(condition + 5, &end, 10);
+            if(*end) return FALSE;
+            for(part = 0; part < possiblePartitionCount; part++){
+                selected[part] &= atLeast ? largestCluster(part) >= k : largestCluster(part) <= k;
+            }
+        } else if(!strncmp(condition, "clusters=", 9)){
+            k = strtol(condition + 9, &end, 10);
+            if(*end) return FALSE;
+            for(part = 0; part < possiblePartitionCount; part++){
+                selected[part] &= clusterCount(part) == k;
+            }
+        } else {
+            k = strtol(condition, &end, 10);
+            if(*end || end == condition || k < 0 || k >= possiblePartitionCount) return FALSE;
+            for(part = 0; part < possiblePartitionCount; part++){
+                selected[part] &= part == k;
+            }
+        }
+    }
+    return TRUE;
+}
+
+void answerPartitions(FILE *f){
+    int part;
+    for(part = 0; part < possiblePartitionCount; part++){
+        fprintf(f, "%d: ", part);
+        printPartition(f, part);
+    }
+}
+
+void answerCount(FILE *f, char *range, char *selector){
+    int first, last, part, i, found = 0;
+    char *end;
+    boolean *selected = NULL;
+
+    first = last = strtol(range, &end, 10);
+    if(*end == '-'){
+        last = strtol(end + 1, &end, 10);
+    }
+    if(*end || first > last){
+        fprintf(f, "error: invalid range %s\n", range);
+        return;
+    }
+    if(selector != NULL){
+        selected = allocate(possiblePartitionCount, sizeof(boolean));
+        if(!parseSelector(selector, selected)){
+            fprintf(f, "error: invalid selector\n");
+            free(selected);
+            return;
+        }
+    }
+    for(i = 0; i < indexCount; i++){
+        PARTITIONINDEX *index = indexes + i;
+        if(index->n < first || index->n > last) continue;
+        found++;
+        if(selected != NULL){
+            unsigned long long count = 0;
+            for(part = 0; part < possiblePartitionCount; part++){
+                if(selected[part]) count += index->partitionCount[part];
+            }
+            fprintf(f, "%d %llu\n", index->n, count);
+        } else {
+            for(part = 0; part < possiblePartitionCount; part++){
+                if(index->partitionCount[part]){
+                    fprintf(f, "%d %d %llu - ", index->n, part, index->partitionCount[part]);
+                    printPartition(f, part);
+                }
+            }
+        }
+    }
+    if(!found){
+        fprintf(f, "error: no index for n = %s\n", range);
+    }
+    free(selected);
+}
+
+void answerRanks(FILE *f, char *n, char *selector, char *limitString){
+    unsigned long long graph, limit = ~0ULL, written = 0;
+    int part, single = -1;
+
+    PARTITIONINDEX *index = findIndex(atoi(n));
+    if(index == NULL){
+        fprintf(f, "error: no index for n = %s\n", n);
+        return;
+    }
+    if(limitString != NULL){
+        limit = strtoull(limitString, NULL, 10);
+    }
+    boolean *selected = allocate(possiblePartitionCount, sizeof(boolean));
+    if(!parseSelector(selector, selected)){
+        fprintf(f, "error: invalid selector\n");
+        free(selected);
+        return;
+    }
+    for(part = 0; part < possiblePartitionCount; part++){
+        if(selected[part]){
+            single = single == -1 ? part : -2;
+        }
+    }
+
+    if(single >= 0 && index->entrySize == 1){
+        //a single partition in a byte-sized index: let memchr find the entries
+        const unsigned char *p = index->entries, *end = index->entries + index->graphCount;
+        while(written < limit && (p = memchr(p, single, end - p)) != NULL){
+            fprintf(f, "%llu\n", (unsigned long long)(p - index->entries) + 1);
+            written++;
+            p++;
+        }
+    } else if(single != -1){
+        for(graph = 0; graph < index->graphCount && written < limit; graph++){
+            if(selected[entry(index, graph)]){
+                fprintf(f, "%llu\n", graph + 1);
+                written++;
+            }
+        }
+    }
+    free(selected);
+}
+
+void answerQuery(FILE *f, char *query){
+    char *words[5];
+    int wordCount = 0;
+    char *word;
+
+    for(word = strtok(query, " \t\r\n"); word != NULL && wordCount < 5; word = strtok(NULL, " \t\r\n")){
+        words[wordCount++] = word;
+    }
+    if(wordCount == 0){
+        return;
+    }
+    if(!strcmp(words[0], "partitions") && wordCount == 1){
+        answerPartitions(f);
+    } else if(!strcmp(words[0], "count") && (wordCount == 2 || wordCount == 3)){
+        answerCount(f, words[1], wordCount == 3 ? words[2] : NULL);
+    } else if(!strcmp(words[0], "ranks") && (wordCount == 3 || wordCount == 4)){
+        answerRanks(f, words[1], words[2], wordCount == 4 ? words[3] : NULL);
+    } else {
+        fprintf(f, "error: unknown query (use partitions, count n[-m] [selector] or ranks n selector [limit])\n");
+    }
+    fprintf(f, ".\n");
+    fflush(f);
+}
+
+/* Answers the queries of a client until it closes the connection. */
+void serveClient(int fd){
+    char query[MAXQUERYLENGTH];
+    FILE *in = fdopen(dup(fd), "r");
+    FILE *out = fdopen(fd, "w");
+    if(in == NULL || out == NULL){
+        fprintf(stderr, "Could not open the connection.\n");
+        if(in != NULL) fclose(in); else close(fd);
+        return;
+    }
+    while(fgets(query, MAXQUERYLENGTH, in) != NULL && !ferror(out)){
+        answerQuery(out, query);
+    }
+    fclose(in);
+    fclose(out);
+}
+
+//=============== Socket ===========================
+
+const char *socketName = NULL;
+
+void removeSocket(int signal){
+    unlink(socketName);
+    _exit(0);
+}
+
+int openSocket(){
+    struct sockaddr_un address;
+    struct stat status;
+
+    if(strlen(socketName) >= sizeof(address.sun_path)){
+        fprintf(stderr, "The name of the socket is too long -- exiting!\n");
+        exit(1);
+    }
+    //remove a socket that was left behind, but never another file
+    if(stat(socketName, &status) == 0 && S_ISSOCK(status.st_mode)){
+        unlink(socketName);
+    }
+    memset(&address, 0, sizeof(struct sockaddr_un));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketName);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || bind(fd, (struct sockaddr *)&address, sizeof(struct sockaddr_un)) ||
+            listen(fd, 16)){
+        fprintf(stderr, "Could not listen on %s: %s -- exiting!\n", socketName, strerror(errno));
+        exit(1);
+    }
+    signal(SIGINT, removeSocket);
+    signal(SIGTERM, removeSocket);
+    signal(SIGPIPE, SIG_IGN);
+    return fd;
+}
+
+//====================== USAGE =======================
+
+void help(char *name) {
+    fprintf(stderr, "The program %s answers queries about the partitions of the\n", name);
+    fprintf(stderr, "cluster sizes using partition indexes written by count_all_clusters.\n\n");
+    fprintf(stderr, "Usage\n=====\n");
+    fprintf(stderr, " %s [options] n=file ...\n\n", name);
+    fprintf(stderr, "\nEach argument gives the partition index for the fullerenes with n vertices.\n");
+    fprintf(stderr, "Queries are read from the socket, one per line, and each answer ends with a\n");
+    fprintf(stderr, "line containing a single dot. One client is handled at a time: the next\n");
+    fprintf(stderr, "connection is accepted when the current client closes its connection.\n");
+    fprintf(stderr, "The queries are:\n");
+    fprintf(stderr, "    partitions\n");
+    fprintf(stderr, "       List the partitions with their numbers.\n");
+    fprintf(stderr, "    count n[-m] [selector]\n");
+    fprintf(stderr, "       The number of graphs of each partition for n (up to m), or the number\n");
+    fprintf(stderr, "       of graphs that match the selector.\n");
+    fprintf(stderr, "    ranks n selector [limit]\n");
+    fprintf(stderr, "       The ranks of the graphs for n that match the selector, at most limit.\n");
+    fprintf(stderr, "A selector is a list of conditions separated by commas: a partition number,\n");
+    fprintf(stderr, "has=k (a cluster of size k), max>=k or max<=k (the largest cluster) and\n");
+    fprintf(stderr, "clusters=k (the number of clusters).\n\n");
+    fprintf(stderr, "Valid options\n=============\n");
+    fprintf(stderr, "    -h, --help\n");
+    fprintf(stderr, "       Print this help and return.\n");
+    fprintf(stderr, "    -s, --socket file\n");
+    fprintf(stderr, "       Listen on the Unix socket with this name. The default is\n");
+    fprintf(stderr, "       cluster_server.socket.\n");
+}
+
+void usage(char *name) {
+    fprintf(stderr, "Usage: %s [options] n=file ...\n", name);
+    fprintf(stderr, "For more information type: %s -h \n\n", name);
+}
+
+int main(int argc, char *argv[]) {
+
+    /*=========== commandline parsing ===========*/
+
+    int c, i;
+    char *name = argv[0];
+    static struct option long_options[] = {
+        {"help", no_argument, NULL, 'h'},
+        {"socket", required_argument, NULL, 's'},
+        {NULL, 0, NULL, 0}
+    };
+    int option_index = 0;
+
+    socketName = "cluster_server.socket";
+
+    while ((c = getopt_long(argc, argv, "hs:", long_options, &option_index)) != -1) {
+        switch (c) {
+            case 'h':
+                help(name);
+                return EXIT_SUCCESS;
+            case 's':
+                socketName = optarg;
+                break;
+            case '?':
+                usage(name);
+                return EXIT_FAILURE;
+            default:
+                fprintf(stderr, "Illegal option %c.\n", c);
+                usage(name);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if(optind == argc){
+        fprintf(stderr, "No partition indexes were given.\n");
+        usage(name);
+        return EXIT_FAILURE;
+    }
+
+    /*=========== load the indexes ===========*/
+
+    indexCount = argc - optind;
+    indexes = allocate(indexCount, sizeof(PARTITIONINDEX));
+    for(i = 0; i < indexCount; i++){
+        loadIndex(indexes + i, argv[optind + i]);
+    }
+    qsort(indexes, indexCount, sizeof(PARTITIONINDEX), compareIndexes);
+    for(i = 1; i < indexCount; i++){
+        if(indexes[i].n == indexes[i - 1].n){
+            fprintf(stderr, "There are two indexes for n = %d.\n", indexes[i].n);
+            return EXIT_FAILURE;
+        }
+    }
+    for(i = 0; i < indexCount; i++){
+        fprintf(stderr, "n = %d: %llu graph%s from %s\n", indexes[i].n, indexes[i].graphCount,
+                indexes[i].graphCount == 1 ? "" : "s", indexes[i].fileName);
+    }
+
+    /*=========== answer queries ===========*/
+
+    int listener = openSocket();
+    fprintf(stderr, "Listening on %s.\n", socketName);
+    while(1){
+        int client = accept(listener, NULL, NULL);
+        if(client < 0){
+            if(errno == EINTR || errno == ECONNABORTED) continue;
+            fprintf(stderr, "Could not accept a connection: %s -- exiting!\n", strerror(errno));
+            unlink(socketName);
+            return EXIT_FAILURE;
+        }
+        serveClient(client);
+    }
+}
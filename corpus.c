@@ -0,0 +1,266 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "corpus.h"
+
+#define HEADER ">>planar_code<<"
+
+/* Stores a 16-bit value in little endian byte order and advances p. */
+#define STORESHORT(p, value) do { (p)[0] = (value) & 0xFF; (p)[1] = (value) >> 8; (p) += 2; } while(0)
+
+/* The clockwise rotations of the icosahedron, the dodecahedron (C20) and the
+ * buckminsterfullerene (C60). Vertices are numbered from 0.
+ */
+static const int icosahedron[12][5] = {
+    {4, 6, 3, 1, 2}, {7, 5, 2, 0, 3}, {5, 8, 4, 0, 1}, {6, 9, 7, 1, 0},
+    {8, 10, 6, 0, 2}, {7, 11, 8, 2, 1}, {4, 10, 9, 3, 0}, {9, 11, 5, 1, 3},
+    {11, 10, 4, 2, 5}, {10, 11, 7, 3, 6}, {8, 11, 9, 6, 4}, {9, 10, 8, 5, 7}
+};
+
+static const int c20[20][3] = {
+    {4, 1, 2}, {0, 5, 3}, {6, 8, 0}, {9, 6, 1}, {10, 7, 0},
+    {7, 11, 1}, {12, 2, 3}, {13, 5, 4}, {14, 10, 2}, {11, 15, 3},
+    {8, 16, 4}, {17, 9, 5}, {15, 14, 6}, {16, 17, 7}, {18, 8, 12},
+    {19, 12, 9}, {18, 13, 10}, {19, 11, 13}, {19, 16, 14}, {17, 18, 15}
+};
+
+static const int c60[60][3] = {
+    {4, 1, 2}, {0, 5, 3}, {6, 10, 0}, {11, 7, 1}, {12, 8, 0},
+    {9, 13, 1}, {14, 2, 7}, {15, 6, 3}, {16, 9, 4}, {17, 5, 8},
+    {18, 12, 2}, {19, 3, 13}, {20, 4, 10}, {21, 11, 5}, {22, 23, 6},
+    {24, 22, 7}, {25, 27, 8}, {27, 26, 9}, {23, 28, 10}, {29, 24, 11},
+    {30, 25, 12}, {26, 31, 13}, {32, 14, 15}, {33, 18, 14}, {34, 15, 19},
+    {35, 16, 20}, {36, 21, 17}, {37, 17, 16}, {38, 30, 18}, {31, 39, 19},
+    {28, 40, 20}, {41, 29, 21}, {43, 42, 22}, {42, 38, 23}, {39, 43, 24},
+    {40, 44, 25}, {45, 41, 26}, {44, 45, 27}, {46, 28, 33}, {47, 34, 29},
+    {48, 35, 30}, {49, 31, 36}, {50, 33, 32}, {51, 32, 34}, {52, 37, 35},
+    {53, 36, 37}, {54, 48, 38}, {49, 55, 39}, {46, 56, 40}, {57, 47, 41},
+    {51, 54, 42}, {55, 50, 43}, {56, 53, 44}, {52, 57, 45}, {58, 46, 50},
+    {59, 51, 47}, {58, 52, 48}, {59, 49, 53}, {59, 56, 54}, {57, 58, 55}
+};
+
+unsigned long long nextRandom(unsigned long long *state){
+    unsigned long long x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static void reserve(CORPUS *corpus, size_t length){
+    if(corpus->length + length <= corpus->capacity) return;
+    while(corpus->length + length > corpus->capacity){
+        corpus->capacity *= 2;
+    }
+    corpus->data = realloc(corpus->data, corpus->capacity);
+    if(corpus->data == NULL){
+        fprintf(stderr, "Insufficient memory for the corpus -- exiting!\n");
+        exit(1);
+    }
+}
+
+void initCorpus(CORPUS *corpus){
+    corpus->capacity = 1 << 16;
+    corpus->data = malloc(corpus->capacity);
+    if(corpus->data == NULL){
+        fprintf(stderr, "Insufficient memory for the corpus -- exiting!\n");
+        exit(1);
+    }
+    memcpy(corpus->data, HEADER, strlen(HEADER));
+    corpus->length = strlen(HEADER);
+    corpus->graphCount = 0;
+}
+
+void clearCorpus(CORPUS *corpus){
+    corpus->length = 0;
+    corpus->graphCount = 0;
+}
+
+void freeCorpus(CORPUS *corpus){
+    free(corpus->data);
+    corpus->data = NULL;
+    corpus->length = corpus->capacity = 0;
+    corpus->graphCount = 0;
+}
+
+/* Returns storage for at least count integers, reusing *storage when it is
+ * large enough.
+ */
+static int *ensureIntStorage(int **storage, int *capacity, int count){
+    if(count > *capacity){
+        free(*storage);
+        *capacity = count;
+        *storage = malloc(count * sizeof(int));
+        if(*storage == NULL){
+            fprintf(stderr, "Insufficient memory for the corpus -- exiting!\n");
+            exit(1);
+        }
+    }
+    return *storage;
+}
+
+/* Appends the planar code of the graph with n vertices in which vertex v has
+ * the neighbours rotation[v*maxDegree] up to rotation[v*maxDegree+degree[v]-1]
+ * in clockwise order. The vertices are relabelled with a random permutation
+ * and each rotation starts at a random neighbour. Graphs with more than 254
+ * vertices are stored in the 16-bit format.
+ */
+static void addRelabelledCode(CORPUS *corpus, int n, const int *rotation,
+        const int *degree, int maxDegree, unsigned long long *seed){
+    static int *permutation = NULL, *inverse = NULL;
+    static int permutationCapacity = 0, inverseCapacity = 0;
+    int i, j;
+
+    ensureIntStorage(&permutation, &permutationCapacity, n);
+    ensureIntStorage(&inverse, &inverseCapacity, n);
+
+    for(i = 0; i < n; i++){
+        permutation[i] = i;
+    }
+    for(i = n - 1; i > 0; i--){
+        j = nextRandom(seed) % (i + 1);
+        int swap = permutation[i];
+        permutation[i] = permutation[j];
+        permutation[j] = swap;
+    }
+    for(i = 0; i < n; i++){
+        inverse[permutation[i]] = i;
+    }
+
+    if(n + 1 <= 255){
+        reserve(corpus, 1 + n*(maxDegree + 1));
+        unsigned char *code = corpus->data + corpus->length;
+        *code++ = n;
+        for(i = 0; i < n; i++){
+            int v = inverse[i];
+            int start = degree[v] ? nextRandom(seed) % degree[v] : 0;
+            for(j = 0; j < degree[v]; j++){
+                *code++ = permutation[rotation[v*maxDegree + (start + j) % degree[v]]] + 1;
+            }
+            *code++ = 0;
+        }
+        corpus->length = code - corpus->data;
+    } else {
+        reserve(corpus, 1 + 2*(1 + n*(maxDegree + 1)));
+        unsigned char *code = corpus->data + corpus->length;
+        *code++ = 0;
+        STORESHORT(code, n);
+        for(i = 0; i < n; i++){
+            int v = inverse[i];
+            int start = degree[v] ? nextRandom(seed) % degree[v] : 0;
+            for(j = 0; j < degree[v]; j++){
+                STORESHORT(code, permutation[rotation[v*maxDegree + (start + j) % degree[v]]] + 1);
+            }
+            STORESHORT(code, 0);
+        }
+        corpus->length = code - corpus->data;
+    }
+    corpus->graphCount++;
+}
+
+void addPentagonGraphs(CORPUS *corpus, int count, unsigned long long *seed){
+    int rotation[12*5], degree[12];
+    int keep[12][12];
+    int i, j, v;
+
+    for(i = 0; i < count; i++){
+        //the probability that an edge is kept is u^3 for u uniform in [0,1)
+        double u = (nextRandom(seed) >> 11) * (1.0 / 9007199254740992.0);
+        unsigned long long threshold = u * u * u * 18446744073709551615.0;
+
+        for(v = 0; v < 12; v++){
+            for(j = 0; j < 5; j++){
+                int w = icosahedron[v][j];
+                if(v < w){
+                    keep[v][w] = keep[w][v] = nextRandom(seed) < threshold;
+                }
+            }
+        }
+        for(v = 0; v < 12; v++){
+            degree[v] = 0;
+            for(j = 0; j < 5; j++){
+                if(keep[v][icosahedron[v][j]]){
+                    rotation[v*5 + degree[v]++] = icosahedron[v][j];
+                }
+            }
+        }
+        addRelabelledCode(corpus, 12, rotation, degree, 5, seed);
+    }
+}
+
+void addFullerenes(CORPUS *corpus, int count, unsigned long long *seed){
+    static const int degree[60] = {
+        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3
+    };
+    int i;
+
+    for(i = 0; i < count; i++){
+        if(i % 2){
+            addRelabelledCode(corpus, 60, &c60[0][0], degree, 3, seed);
+        } else {
+            addRelabelledCode(corpus, 20, &c20[0][0], degree, 3, seed);
+        }
+    }
+}
+
+/* The (5,0) nanotube with length rings of hexagons is built from the top
+ * pentagon a_0 .. a_4, length + 1 zigzag rings u_0 d_0 u_1 d_1 .. u_4 d_4 and
+ * the bottom pentagon b_0 .. b_4. The vertex a_i is adjacent to u_i of the
+ * first ring, d_i is adjacent to u_i of the next ring, and d_i of the last ring
+ * is adjacent to b_i. For length 0 this is C20.
+ */
+void addNanotubes(CORPUS *corpus, int count, int maxLength, unsigned long long *seed){
+    static int *rotation = NULL, *degree = NULL;
+    static int rotationCapacity = 0, degreeCapacity = 0;
+    int i, j, r;
+
+    for(i = 0; i < count; i++){
+        int length = nextRandom(seed) % (maxLength + 1);
+        int n = 20 + 10*length;
+        int bottom = 5 + 10*(length + 1);
+
+        ensureIntStorage(&rotation, &rotationCapacity, 3*n);
+        ensureIntStorage(&degree, &degreeCapacity, n);
+        for(j = 0; j < n; j++){
+            degree[j] = 3;
+        }
+
+        for(j = 0; j < 5; j++){
+            int *a = rotation + 3*j;
+            a[0] = (j + 1) % 5;
+            a[1] = (j + 4) % 5;
+            a[2] = 5 + 2*j;
+
+            int *b = rotation + 3*(bottom + j);
+            b[0] = bottom + (j + 1) % 5;
+            b[1] = bottom - 10 + 2*j + 1;
+            b[2] = bottom + (j + 4) % 5;
+        }
+        for(r = 0; r <= length; r++){
+            int ring = 5 + 10*r;
+            for(j = 0; j < 5; j++){
+                int *u = rotation + 3*(ring + 2*j);
+                u[0] = r ? ring - 10 + 2*j + 1 : j;
+                u[1] = ring + (2*j + 9) % 10;
+                u[2] = ring + 2*j + 1;
+
+                int *d = rotation + 3*(ring + 2*j + 1);
+                d[0] = ring + (2*j + 2) % 10;
+                d[1] = ring + 2*j;
+                d[2] = r < length ? ring + 10 + 2*j : bottom + j;
+            }
+        }
+        addRelabelledCode(corpus, n, rotation, degree, 3, seed);
+    }
+}
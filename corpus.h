@@ -0,0 +1,55 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+/* Deterministic synthetic corpora in planar code. These are used to test and
+ * benchmark the programs without having fullgen available. The same seed
+ * always produces the same corpus.
+ */
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stddef.h>
+
+typedef struct {
+    unsigned char *data; /* starts with the planar code header */
+    size_t length;
+    size_t capacity;
+    int graphCount;
+} CORPUS;
+
+/* Returns the next value of the xorshift64* generator with the given state. */
+unsigned long long nextRandom(unsigned long long *state);
+
+/* Starts an empty corpus that only contains the planar code header. */
+void initCorpus(CORPUS *corpus);
+
+/* Removes all data from the corpus, including the header, so it can be
+ * reused for the next part of a stream.
+ */
+void clearCorpus(CORPUS *corpus);
+
+void freeCorpus(CORPUS *corpus);
+
+/* Appends count pentagonal adjacency graphs of fullerenes, i.e., subgraphs of
+ * the icosahedron with 12 vertices. Most of them are sparse, as is the case
+ * for the larger fullerenes.
+ */
+void addPentagonGraphs(CORPUS *corpus, int count, unsigned long long *seed);
+
+/* Appends count fullerenes. These are alternately C20 and C60 with randomly
+ * relabelled vertices.
+ */
+void addFullerenes(CORPUS *corpus, int count, unsigned long long *seed);
+
+/* Appends count fullerene nanotubes with five-fold symmetry. These consist of
+ * two halves of C20 with a random number (at most maxLength) of rings of five
+ * hexagons in between, and are relabelled randomly.
+ */
+void addNanotubes(CORPUS *corpus, int count, int maxLength, unsigned long long *seed);
+
+#endif /* CORPUS_H */
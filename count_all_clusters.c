@@ -6,12 +6,13 @@
  */
 
 /* This program reads pentagonal adjacency graphs from standard in and
- * counts the different partitions of twelve that appear as cluster sizes.  
+ * counts the different partitions of the number of pentagons (twelve for
+ * fullerenes) that appear as cluster sizes.  
  * 
  * 
  * Compile with:
  *     
- *     cc -o count_all_clusters -O4 count_all_clusters.c
+ *     cc -o count_all_clusters -O4 count_all_clusters.c output.c stats.c progress.c input.c parallel.c cache.c -pthread -lz -llzma -lm
  * 
  */
 
@@ -19,14 +20,25 @@
 #include <stdio.h>
 #include <getopt.h>
 #include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "output.h"
+#include "stats.h"
+#include "progress.h"
+#include "input.h"
+#include "parallel.h"
+#include "cache.h"
 
 
 #ifndef MAXN
-#define MAXN 12            /* the maximum number of vertices */
+#define MAXN 12            /* the initial maximum number of vertices */
 #endif
-#define MAXE (6*MAXN-12)    /* the maximum number of oriented edges */
-#define MAXVAL (MAXN-1)  /* the maximum degree of a vertex */
-#define MAXCODELENGTH (MAXN+MAXE+3)
+#define EDGECOUNT(n) (6*(n)-12)    /* the maximum number of oriented edges */
+#define MAXVAL (maxn-1)  /* the maximum degree of a vertex */
+#define CODELENGTH(n) ((n)+EDGECOUNT(n)+3)
 
 #define FALSE 0
 #define TRUE  1
@@ -42,102 +54,484 @@ typedef struct e /* The data type used for edges */ {
     struct e *inverse; /* the edge that is inverse to this one */
 } EDGE;
 
-EDGE *firstedge[MAXN]; /* pointer to arbitrary edge out of vertex i. */
-int degree[MAXN];
+/* The storage for the graphs is sized at runtime. The static arrays are used
+ * as long as the graphs have at most MAXN vertices. Once a larger graph is read
+ * (or a larger size is requested with --max-n) the storage moves to the heap,
+ * where it is reused for all later graphs. Each thread has its own storage,
+ * which is attached on the first call to ensureCapacity.
+ */
+__thread int maxn = MAXN; /* the number of vertices for which storage is available */
+
+__thread EDGE *firstedgeStorage[MAXN];
+__thread int degreeStorage[MAXN];
+__thread EDGE edgesStorage[EDGECOUNT(MAXN)];
 
-EDGE edges[MAXE];
+__thread EDGE **firstedge = NULL; /* pointer to arbitrary edge out of vertex i. */
+__thread int *degree = NULL;
+
+__thread EDGE *edges = NULL;
 
 int numberOfGraphs = 0;
 
-int nv;
-int ne;
-
-/*  1: 0 - 12
- *  2: 0 - 6
- *  3: 0 - 4
- *  4: 0 - 3
- *  5: 0 - 2
- *  6: 0 - 2
- *  7: 0 - 1
- *  8: 0 - 1
- *  9: 0 - 1
- * 10: 0 - 1
- * 11: 0 - 1
- * 12: 0 - 1
+__thread int nv;
+__thread int ne;
+
+/* The number of pentagons, i.e., the number of vertices in each pentagonal
+ * adjacency graph. This is 12 for fullerenes and 6 for nanotube caps.
  */
-int partitions2Number[13][7][5][4][3][3][2][2][2][2][2][2];
+int pentagonCount = 12;
+
+/* A partition of pentagonCount is stored as the number of clusters of each
+ * size. There are at most pentagonCount/s clusters of size s, so a partition
+ * can be numbered as a mixed radix number in which the digit for size s has
+ * base pentagonCount/s + 1. For fullerenes this gives the following ranges.
+ *
+ *  1: 0 - 12
+ *  2: 0 -  6
+ *  3: 0 -  4
+ *  4: 0 -  3
+ *  5: 0 -  2
+ *  6: 0 -  2
+ *  7: 0 -  1
+ *  8: 0 -  1
+ *  9: 0 -  1
+ * 10: 0 -  1
+ * 11: 0 -  1
+ * 12: 0 -  1
+ *
+ * partitionWeight[s-1] is the weight of the digit for size s. As long as the
+ * product of the bases is at most MAXDIRECTTABLESIZE, the number of a partition
+ * is looked up directly in partitions2Number. Otherwise the possible keys are
+ * sorted in partitionKeys and looked up using binary search.
+ */
+#define MAXDIRECTTABLESIZE (1<<22)
+
+typedef unsigned long long PARTITIONKEY;
+
+PARTITIONKEY *partitionWeight;
+PARTITIONKEY partitionKeyRange;
 
-int possiblePartitions[77][12];
+int *partitions2Number = NULL;
+PARTITIONKEY *partitionKeys = NULL;
+int *partitionKeyNumbers = NULL;
+
+int *possiblePartitions; /* the partition with number i starts at i*pentagonCount */
 int possiblePartitionCount;
-int currentPossiblePartition[12];
+int possiblePartitionCapacity;
+int *currentPossiblePartition;
+
+/* Each thread counts the partitions in its own table. The table of the main
+ * thread also holds the totals, to which the worker threads add their counts
+ * after each batch.
+ */
+__thread int *partitionCount;
+int *partitionTotals;
 
-int partitionCount[77];
+void *allocate(size_t count, size_t size){
+    void *storage = calloc(count, size);
+    if(storage == NULL){
+        fprintf(stderr, "Insufficient memory for the partition tables -- exiting!\n");
+        exit(1);
+    }
+    return storage;
+}
 
-void buildPartitions_recursive(int currentSize){
+void storePossiblePartition(){
     int i;
-    int sum = 0;
-    for(i=0; i<12; i++){
-        sum+=(i+1)*currentPossiblePartition[i];
-    }
-    if(sum==12){
-        for(i=0; i<12; i++){
-            possiblePartitions[possiblePartitionCount][i] = currentPossiblePartition[i];
-        }
-        partitions2Number[currentPossiblePartition[0]]
-                  [currentPossiblePartition[1]]
-                  [currentPossiblePartition[2]]
-                  [currentPossiblePartition[3]]
-                  [currentPossiblePartition[4]]
-                  [currentPossiblePartition[5]]
-                  [currentPossiblePartition[6]]
-                  [currentPossiblePartition[7]]
-                  [currentPossiblePartition[8]]
-                  [currentPossiblePartition[9]]
-                  [currentPossiblePartition[10]]
-                  [currentPossiblePartition[11]] = possiblePartitionCount;
-        possiblePartitionCount++;
+    if(possiblePartitionCount == possiblePartitionCapacity){
+        possiblePartitionCapacity *= 2;
+        possiblePartitions = realloc(possiblePartitions,
+                possiblePartitionCapacity * pentagonCount * sizeof(int));
+        if(possiblePartitions == NULL){
+            fprintf(stderr, "Insufficient memory for the partition tables -- exiting!\n");
+            exit(1);
+        }
+    }
+    for(i=0; i<pentagonCount; i++){
+        possiblePartitions[possiblePartitionCount*pentagonCount + i] = currentPossiblePartition[i];
+    }
+    possiblePartitionCount++;
+}
+
+void buildPartitions_recursive(int currentSize, int sum){
+    if(sum==pentagonCount){
+        storePossiblePartition();
         return;
     }
-    if(sum + currentSize <= 12){
+    if(sum + currentSize <= pentagonCount){
         currentPossiblePartition[currentSize-1]++;
-        buildPartitions_recursive(currentSize);
+        buildPartitions_recursive(currentSize, sum + currentSize);
         currentPossiblePartition[currentSize-1]--;
     }
     if(currentSize > 1){
-        buildPartitions_recursive(currentSize-1);
+        buildPartitions_recursive(currentSize-1, sum);
     }
 }
 
+PARTITIONKEY getPartitionKey(int *partition){
+    int i;
+    PARTITIONKEY key = 0;
+    for(i=0; i<pentagonCount; i++){
+        key += partition[i]*partitionWeight[i];
+    }
+    return key;
+}
+
+int comparePartitionKeys(const void *a, const void *b){
+    PARTITIONKEY keyA = partitionKeys[*(int *)a];
+    PARTITIONKEY keyB = partitionKeys[*(int *)b];
+    return keyA < keyB ? -1 : (keyA > keyB);
+}
+
+/* Builds the tables for all partitions of pentagonCount. The partitions are
+ * numbered in the same order for every run, so the numbers can be used to
+ * refer to partitions.
+ */
 void buildPartitions(){
     int i;
-    for(i=0; i<12; i++){
-        currentPossiblePartition[i]=0;
+    
+    partitionWeight = allocate(pentagonCount, sizeof(PARTITIONKEY));
+    partitionKeyRange = 1;
+    for(i=0; i<pentagonCount; i++){
+        partitionWeight[i] = partitionKeyRange;
+        if(partitionKeyRange > ~0ULL / (pentagonCount/(i+1) + 1)){
+            fprintf(stderr, "Partitions of %d are not supported -- exiting!\n", pentagonCount);
+            exit(1);
+        }
+        partitionKeyRange *= pentagonCount/(i+1) + 1;
     }
+    
+    currentPossiblePartition = allocate(pentagonCount, sizeof(int));
+    possiblePartitionCapacity = 64;
+    possiblePartitions = allocate(possiblePartitionCapacity * pentagonCount, sizeof(int));
     possiblePartitionCount = 0;
-    buildPartitions_recursive(12);
+    buildPartitions_recursive(pentagonCount, 0);
+    
+    partitionCount = allocate(possiblePartitionCount, sizeof(int));
+    partitionTotals = partitionCount;
+    
+    if(partitionKeyRange <= MAXDIRECTTABLESIZE){
+        partitions2Number = allocate(partitionKeyRange, sizeof(int));
+        for(i=0; i<possiblePartitionCount; i++){
+            partitions2Number[getPartitionKey(possiblePartitions + i*pentagonCount)] = i;
+        }
+    } else {
+        int *order = allocate(possiblePartitionCount, sizeof(int));
+        PARTITIONKEY *keys = allocate(possiblePartitionCount, sizeof(PARTITIONKEY));
+        partitionKeys = allocate(possiblePartitionCount, sizeof(PARTITIONKEY));
+        partitionKeyNumbers = allocate(possiblePartitionCount, sizeof(int));
+        for(i=0; i<possiblePartitionCount; i++){
+            partitionKeys[i] = getPartitionKey(possiblePartitions + i*pentagonCount);
+            order[i] = i;
+        }
+        qsort(order, possiblePartitionCount, sizeof(int), comparePartitionKeys);
+        for(i=0; i<possiblePartitionCount; i++){
+            keys[i] = partitionKeys[order[i]];
+            partitionKeyNumbers[i] = order[i];
+        }
+        free(partitionKeys);
+        free(order);
+        partitionKeys = keys;
+    }
 }
 
-void printPartition(FILE *f, int part, boolean newline){
+int getPartitionNumber(PARTITIONKEY key){
+    if(partitions2Number != NULL){
+        return partitions2Number[key];
+    }
+    int low = 0, high = possiblePartitionCount - 1;
+    while(low < high){
+        int middle = (low + high)/2;
+        if(partitionKeys[middle] < key){
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return partitionKeyNumbers[low];
+}
+
+void writePartition(int part){
     int i, j;
     
-    for(i = 11; i >= 0; i--){
-        for(j = 0; j < possiblePartitions[part][i]; j++){
-            fprintf(f, "%d ", i+1);
+    for(i = pentagonCount - 1; i >= 0; i--){
+        for(j = 0; j < possiblePartitions[part*pentagonCount + i]; j++){
+            writeInt(i+1);
+            writeByte(' ');
+        }
+    }
+    writeByte('\n');
+}
+
+/* Writes the partitions that were found so far for a progress report. */
+void reportPartitionCounts(FILE *f){
+    int c, i, j;
+    
+    for(c = 0; c < possiblePartitionCount; c++){
+        int count = __atomic_load_n(partitionTotals + c, __ATOMIC_RELAXED);
+        if(count){
+            fprintf(f, "%8d - ", count);
+            for(i = pentagonCount - 1; i >= 0; i--){
+                for(j = 0; j < possiblePartitions[c*pentagonCount + i]; j++){
+                    fprintf(f, "%d ", i+1);
+                }
+            }
+            fprintf(f, "\n");
         }
     }
-    if(newline)
-        fprintf(f, "\n");
 }
 
 //////////////////////////////////////////////////////////////////////////////
 
-//=============== Checking for property ===========================
+//=============== Partition index ===========================
 
-int currentPartition[12];
+/* With --partition-index the partition number of each graph is written to a
+ * file, in the order of the input, after a small header. The numbers are the
+ * ones from buildPartitions, so the index can be queried without the graphs
+ * (e.g., by cluster_server). The number of graphs follows from the size of
+ * the file.
+ */
+#define PARTITIONINDEXMAGIC "PARTIDX1"
 
-boolean visited[12];
-boolean currentCluster[12];
-int currentClusterSize;
+typedef struct {
+    char magic[8];
+    unsigned int pentagonCount;
+    unsigned int entrySize; /* the number of bytes per graph: 1 or 2 */
+} PARTITIONINDEXHEADER;
+
+int partitionIndexFd = -1;
+
+/* All threads write the index through the output layer, with the index
+ * as the file descriptor of their buffer.
+ */
+void startPartitionIndex(const char *fileName){
+    partitionIndexFd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(partitionIndexFd < 0){
+        fprintf(stderr, "Could not open %s -- exiting!\n", fileName);
+        exit(1);
+    }
+    if(possiblePartitionCount > 65536){
+        fprintf(stderr, "There are too many partitions for a partition index -- exiting!\n");
+        exit(1);
+    }
+
+    PARTITIONINDEXHEADER header;
+    memset(&header, 0, sizeof(PARTITIONINDEXHEADER));
+    memcpy(header.magic, PARTITIONINDEXMAGIC, sizeof(header.magic));
+    header.pentagonCount = pentagonCount;
+    header.entrySize = possiblePartitionCount <= 256 ? 1 : 2;
+
+    flushOutput();
+    outputBuffer.fd = partitionIndexFd;
+    writeBytes(&header, sizeof(PARTITIONINDEXHEADER));
+}
+
+static inline void writePartitionIndexEntry(int partitionNumber){
+    if(possiblePartitionCount <= 256){
+        writeByte(partitionNumber);
+    } else {
+        writeShort(partitionNumber);
+    }
+}
+
+void finishPartitionIndex(){
+    flushOutput();
+    if(close(partitionIndexFd)){
+        fprintf(stderr, "Could not write the partition index -- exiting!\n");
+        exit(1);
+    }
+    outputBuffer.fd = 1;
+}
+
+//=============== Feature store ===========================
+
+/* With --features a table with one row per graph is written in a columnar
+ * file. The file starts with a FEATUREHEADER, which gives the offset and the
+ * width (1 or 2 bytes) of each column; the columns are stored one after the
+ * other, each as a dense array of little endian values aligned to 64 bytes.
+ *
+ * The number of graphs is only known at the end, so the rows are first
+ * written to a temporary file in groups of at most BATCHGRAPHS rows, each
+ * group stored column by column after its number of rows. The threads write
+ * the groups through the output layer, so the order of the input is kept.
+ * At the end the groups are copied to the columns of the final file.
+ */
+#define FEATUREMAGIC "PCFEAT01"
+#define FEATURECOLUMNS 6
+#define FEATUREALIGNMENT 64
+#define FEATURECOPYBUFFER (1<<20)
+
+#define FEATURE_PARTITION 0
+#define FEATURE_EDGES 1 /* the number of edges of the pentagonal adjacency graph */
+#define FEATURE_LARGEST 2 /* the size of the largest cluster */
+#define FEATURE_CLUSTERS 3 /* the number of clusters */
+#define FEATURE_VALID 4 /* whether all clusters are valid (see filter_valid_clusters) */
+#define FEATURE_SIX 5 /* whether there is a cluster with 6 pentagons */
+
+const char *featureNames[FEATURECOLUMNS] = {
+    "partition", "edges", "largest_cluster", "clusters", "valid_clusters", "six_cluster"
+};
+
+typedef struct {
+    char name[16];
+    unsigned int width;
+    unsigned int reserved;
+    unsigned long long offset;
+} FEATURECOLUMN;
+
+typedef struct {
+    char magic[8];
+    unsigned long long graphCount;
+    unsigned int pentagonCount;
+    unsigned int columnCount;
+    FEATURECOLUMN columns[FEATURECOLUMNS];
+} FEATUREHEADER;
+
+int featureFd = -1; /* the temporary file */
+char *featureFileName;
+char *temporaryFeatureFileName;
+int featureWidth[FEATURECOLUMNS];
+
+__thread unsigned short featureRows[FEATURECOLUMNS][BATCHGRAPHS];
+__thread int featureRowCount = 0;
+
+void startFeatures(char *fileName){
+    int c;
+    featureFileName = fileName;
+    temporaryFeatureFileName = allocate(strlen(fileName) + 5, 1);
+    strcpy(temporaryFeatureFileName, fileName);
+    strcat(temporaryFeatureFileName, ".tmp");
+    featureFd = open(temporaryFeatureFileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(featureFd < 0){
+        fprintf(stderr, "Could not open %s -- exiting!\n", temporaryFeatureFileName);
+        exit(1);
+    }
+    for(c = 0; c < FEATURECOLUMNS; c++){
+        featureWidth[c] = 3*pentagonCount <= 255 ? 1 : 2;
+    }
+    featureWidth[FEATURE_PARTITION] = possiblePartitionCount <= 256 ? 1 : 2;
+    featureWidth[FEATURE_VALID] = featureWidth[FEATURE_SIX] = 1;
+    if(possiblePartitionCount > 65536 || 3*pentagonCount > 65535){
+        fprintf(stderr, "The features of graphs with %d pentagons do not fit in the columns -- exiting!\n",
+                pentagonCount);
+        exit(1);
+    }
+    flushOutput();
+    outputBuffer.fd = featureFd;
+}
+
+/* Writes the rows of this thread as a group. */
+void writeFeatureRows(){
+    int c, i;
+    if(featureRowCount == 0){
+        return;
+    }
+    unsigned int count = featureRowCount;
+    writeBytes(&count, sizeof(unsigned int));
+    for(c = 0; c < FEATURECOLUMNS; c++){
+        for(i = 0; i < featureRowCount; i++){
+            if(featureWidth[c] == 1){
+                writeByte(featureRows[c][i]);
+            } else {
+                writeShort(featureRows[c][i]);
+            }
+        }
+    }
+    featureRowCount = 0;
+}
+
+static void readFeatureGroups(FILE *groups, void *data, size_t length){
+    if(fread(data, 1, length, groups) != length){
+        fprintf(stderr, "Could not read %s -- exiting!\n", temporaryFeatureFileName);
+        exit(1);
+    }
+}
+
+static void writeFeatureColumn(int fd, const void *data, size_t length, unsigned long long offset){
+    while(length){
+        ssize_t written = pwrite(fd, data, length, offset);
+        if(written < 0){
+            if(errno == EINTR) continue;
+            fprintf(stderr, "Could not write %s -- exiting!\n", featureFileName);
+            exit(1);
+        }
+        data = (const char *)data + written;
+        length -= written;
+        offset += written;
+    }
+}
+
+/* Copies the groups from the temporary file to the columns of the file. */
+void finishFeatures(){
+    int c;
+    unsigned int count;
+    FEATUREHEADER header;
+    unsigned char *buffers[FEATURECOLUMNS];
+    size_t buffered[FEATURECOLUMNS];
+    unsigned long long position[FEATURECOLUMNS];
+
+    writeFeatureRows();
+    flushOutput();
+    outputBuffer.fd = 1;
+    if(close(featureFd)){
+        fprintf(stderr, "Could not write %s -- exiting!\n", temporaryFeatureFileName);
+        exit(1);
+    }
+
+    memset(&header, 0, sizeof(FEATUREHEADER));
+    memcpy(header.magic, FEATUREMAGIC, sizeof(header.magic));
+    header.graphCount = numberOfGraphs;
+    header.pentagonCount = pentagonCount;
+    header.columnCount = FEATURECOLUMNS;
+    unsigned long long offset = sizeof(FEATUREHEADER);
+    for(c = 0; c < FEATURECOLUMNS; c++){
+        offset = (offset + FEATUREALIGNMENT - 1) / FEATUREALIGNMENT * FEATUREALIGNMENT;
+        strcpy(header.columns[c].name, featureNames[c]);
+        header.columns[c].width = featureWidth[c];
+        header.columns[c].offset = position[c] = offset;
+        offset += header.graphCount * featureWidth[c];
+        buffers[c] = allocate(FEATURECOPYBUFFER, 1);
+        buffered[c] = 0;
+    }
+
+    int fd = open(featureFileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    FILE *groups = fopen(temporaryFeatureFileName, "r");
+    if(fd < 0 || groups == NULL){
+        fprintf(stderr, "Could not open %s -- exiting!\n", fd < 0 ? featureFileName : temporaryFeatureFileName);
+        exit(1);
+    }
+    writeFeatureColumn(fd, &header, sizeof(FEATUREHEADER), 0);
+    while(fread(&count, sizeof(unsigned int), 1, groups) == 1){
+        for(c = 0; c < FEATURECOLUMNS; c++){
+            size_t length = count * featureWidth[c];
+            if(buffered[c] + length > FEATURECOPYBUFFER){
+                writeFeatureColumn(fd, buffers[c], buffered[c], position[c]);
+                position[c] += buffered[c];
+                buffered[c] = 0;
+            }
+            readFeatureGroups(groups, buffers[c] + buffered[c], length);
+            buffered[c] += length;
+        }
+    }
+    for(c = 0; c < FEATURECOLUMNS; c++){
+        writeFeatureColumn(fd, buffers[c], buffered[c], position[c]);
+        position[c] += buffered[c];
+        free(buffers[c]);
+    }
+    //the file ends with the last column, which may be empty
+    if(ftruncate(fd, offset) || close(fd)){
+        fprintf(stderr, "Could not write %s -- exiting!\n", featureFileName);
+        exit(1);
+    }
+    fclose(groups);
+    unlink(temporaryFeatureFileName);
+}
+
+//=============== Checking for property ===========================
+
+__thread boolean *visited;
+__thread int *stack;
+__thread int currentClusterSize;
 
 //some macros for the stack in the next method
 #define PUSH(stack, value) stack[top++] = (value)
@@ -145,25 +539,30 @@ int currentClusterSize;
 #define STACKISEMPTY top==0
 #define STACKISNOTEMPTY top>0
 
-void identifyClusters(){
-    int i, j, top, currentVertex;
-    int stack[12];
+void initClusterStorage(){
+    visited = allocate(pentagonCount, sizeof(boolean));
+    stack = allocate(pentagonCount, sizeof(int));
+}
+
+/* Returns the number of the partition formed by the cluster sizes of a graph
+ * with n vertices. This function is inlined with a constant n for the
+ * pentagonal adjacency graphs of fullerenes, so that case gets its own
+ * specialised copy.
+ */
+static inline int identifyClustersOfOrder(int n){
+    int i, top, currentVertex;
+    PARTITIONKEY key = 0;
     
-    for(i = 0; i < 12; i++){
+    for(i = 0; i < n; i++){
         visited[i] = FALSE;
-        currentPartition[i] = 0;
     }
     
-    for(i = 0; i < 12; i++){
+    for(i = 0; i < n; i++){
         if(!visited[i]){
-            for(j = 0; j < 12; j++){
-                currentCluster[j] = FALSE;
-            }
-            
             //build cluster containing vertex i
             top = 0;
             PUSH(stack, i);
-            visited[i] = currentCluster[i] = TRUE;
+            visited[i] = TRUE;
             currentClusterSize = 1;
             while(STACKISNOTEMPTY){
                 currentVertex = POP(stack);
@@ -174,7 +573,7 @@ void identifyClusters(){
                     do {
                         if (!visited[e->end]) {
                             PUSH(stack, e->end);
-                            visited[e->end] = currentCluster[e->end] = TRUE;
+                            visited[e->end] = TRUE;
                             currentClusterSize++;
                         }
                         e = e->next;
@@ -182,26 +581,165 @@ void identifyClusters(){
                 }
             }
             
-            currentPartition[currentClusterSize-1]++;
+            key += partitionWeight[currentClusterSize-1];
         }
     }
     
-    int partitionNumber = partitions2Number[currentPartition[0]]
-                  [currentPartition[1]]
-                  [currentPartition[2]]
-                  [currentPartition[3]]
-                  [currentPartition[4]]
-                  [currentPartition[5]]
-                  [currentPartition[6]]
-                  [currentPartition[7]]
-                  [currentPartition[8]]
-                  [currentPartition[9]]
-                  [currentPartition[10]]
-                  [currentPartition[11]];
+    return getPartitionNumber(key);
+}
+
+/* Like identifyClustersOfOrder, but also stores the features of the graph in
+ * the next row of featureRows. A cluster is valid under the same conditions as
+ * in filter_valid_clusters: it has at most five pentagons, and the degrees
+ * show that a cluster with three pentagons is a triangle, one with four is K4
+ * minus an edge (degrees 2, 2, 3, 3) and one with five is a fan of three
+ * triangles around a pentagon of degree 4 (degrees 2, 2, 3, 3, 4, 7 edges).
+ */
+int identifyClusterFeatures(){
+    int i, top, currentVertex;
+    int largest = 0, clusters = 0;
+    boolean valid = TRUE, six = FALSE;
+    int degreeFrequency[5];
+    PARTITIONKEY key = 0;
+
+    for(i = 0; i < nv; i++){
+        visited[i] = FALSE;
+    }
+
+    for(i = 0; i < nv; i++){
+        if(!visited[i]){
+            int j;
+            for(j = 0; j < 5; j++){
+                degreeFrequency[j] = 0;
+            }
+            top = 0;
+            PUSH(stack, i);
+            visited[i] = TRUE;
+            currentClusterSize = 1;
+            while(STACKISNOTEMPTY){
+                currentVertex = POP(stack);
+                if(degree[currentVertex] < 5){
+                    degreeFrequency[degree[currentVertex]]++;
+                } else {
+                    valid = FALSE;
+                }
+                if(degree[currentVertex]){
+                    EDGE *e, *elast;
+
+                    e = elast = firstedge[currentVertex];
+                    do {
+                        if (!visited[e->end]) {
+                            PUSH(stack, e->end);
+                            visited[e->end] = TRUE;
+                            currentClusterSize++;
+                        }
+                        e = e->next;
+                    } while (e != elast);
+                }
+            }
+
+            key += partitionWeight[currentClusterSize-1];
+            clusters++;
+            if(currentClusterSize > largest) largest = currentClusterSize;
+            if(currentClusterSize == 6) six = TRUE;
+            if(currentClusterSize == 3){
+                valid &= degreeFrequency[2] == 3;
+            } else if(currentClusterSize == 4){
+                valid &= degreeFrequency[2] == 2 && degreeFrequency[3] == 2;
+            } else if(currentClusterSize == 5){
+                valid &= degreeFrequency[2] == 2 && degreeFrequency[3] == 2 && degreeFrequency[4] == 1;
+            } else if(currentClusterSize > 5){
+                valid = FALSE;
+            }
+        }
+    }
+
+    int partitionNumber = getPartitionNumber(key);
+    featureRows[FEATURE_PARTITION][featureRowCount] = partitionNumber;
+    featureRows[FEATURE_EDGES][featureRowCount] = ne/2;
+    featureRows[FEATURE_LARGEST][featureRowCount] = largest;
+    featureRows[FEATURE_CLUSTERS][featureRowCount] = clusters;
+    featureRows[FEATURE_VALID][featureRowCount] = valid;
+    featureRows[FEATURE_SIX][featureRowCount] = six;
+    if(++featureRowCount == BATCHGRAPHS){
+        writeFeatureRows();
+    }
+    return partitionNumber;
+}
+
+int identifyClusters(){
+    int partitionNumber;
     
-//    partitionAppearance[partitionNumber][partitionCount[partitionNumber]] = numberOfGraphs;
-    partitionCount[partitionNumber]++;
+    if(featureFd >= 0){
+        partitionNumber = identifyClusterFeatures();
+    } else if(nv == 12){
+        partitionNumber = identifyClustersOfOrder(12);
+    } else {
+        partitionNumber = identifyClustersOfOrder(nv);
+    }
     
+    partitionCount[partitionNumber]++;
+    if(partitionIndexFd >= 0){
+        writePartitionIndexEntry(partitionNumber);
+    }
+    return partitionNumber;
+}
+
+void checkPentagonCount(){
+    if(nv!=pentagonCount){
+        fprintf(stderr, "Read a graph with %d vertices while expecting pentagonal adjacency graphs\n", nv);
+        fprintf(stderr, "with %d vertices (use --pentagons to change this) -- exiting!\n", pentagonCount);
+        exit(1);
+    }
+}
+
+//=============== Graph storage ===========================
+
+/* Returns storage for count elements of the given size to replace current.
+ * The contents are not preserved. The initial storage is the static array,
+ * which is never freed.
+ */
+void *resizeStorage(void *current, void *initial, size_t count, size_t size){
+    if(current != initial){
+        free(current);
+    }
+    void *storage = malloc(count * size);
+    if(storage == NULL){
+        fprintf(stderr, "Insufficient memory for the graph storage -- exiting!\n");
+        exit(1);
+    }
+    return storage;
+}
+
+/* Makes sure that graphs with n vertices fit in the graph storage. The storage
+ * grows by at least half of its size to avoid repeated resizing when the
+ * graphs grow gradually.
+ */
+void ensureCapacity(int n){
+    if(firstedge == NULL){
+        //each thread starts with its own static storage
+        firstedge = firstedgeStorage;
+        degree = degreeStorage;
+        edges = edgesStorage;
+    }
+    if(n <= maxn) return;
+    if(n < maxn + maxn/2){
+        n = maxn + maxn/2;
+    }
+    firstedge = resizeStorage(firstedge, firstedgeStorage, n, sizeof(EDGE *));
+    degree = resizeStorage(degree, degreeStorage, n, sizeof(int));
+    edges = resizeStorage(edges, edgesStorage, EDGECOUNT(n), sizeof(EDGE));
+    maxn = n;
+}
+
+void growCodeBuffer(unsigned short **code, int *capacity, int newCapacity){
+    unsigned short *buffer = realloc(*code, newCapacity * sizeof(unsigned short));
+    if(buffer == NULL){
+        fprintf(stderr, "Insufficient memory for a code of length %d -- exiting!\n", newCapacity);
+        exit(1);
+    }
+    *code = buffer;
+    *capacity = newCapacity;
 }
 
 //=============== Reading and decoding planarcode ===========================
@@ -209,15 +747,28 @@ void identifyClusters(){
 EDGE *findEdge(int from, int to) {
     EDGE *e, *elast;
 
-    e = elast = firstedge[from];
-    do {
-        if (e->end == to) {
-            return e;
-        }
-        e = e->next;
-    } while (e != elast);
-    fprintf(stderr, "error while looking for edge from %d to %d.\n", from, to);
-    exit(0);
+    //firstedge of a vertex without neighbours is left over from an earlier graph
+    if (degree[from]) {
+        e = elast = firstedge[from];
+        do {
+            if (e->end == to) {
+                return e;
+            }
+            e = e->next;
+        } while (e != elast);
+    }
+    fprintf(stderr, "Invalid code: vertex %d is a neighbour of %d, but not the other way around -- exiting!\n",
+            from + 1, to + 1);
+    exit(1);
+}
+
+/* Exits if the neighbour in the code of vertex v is not a vertex of the graph. */
+static inline void checkNeighbour(int v, unsigned short neighbour){
+    if (neighbour > nv) {
+        fprintf(stderr, "Invalid code: vertex %d has neighbour %d in a graph with %d vertices -- exiting!\n",
+                v + 1, neighbour, nv);
+        exit(1);
+    }
 }
 
 void decodePlanarCode(unsigned short* code) {
@@ -230,9 +781,12 @@ void decodePlanarCode(unsigned short* code) {
     nv = code[0];
     codePosition = 1;
 
+    ensureCapacity(nv);
+
     for (i = 0; i < nv; i++) {
         degree[i] = 0;
         if(code[codePosition]){
+            checkNeighbour(i, code[codePosition]);
             firstedge[i] = edges + edgeCounter;
             edges[edgeCounter].start = i;
             edges[edgeCounter].end = code[codePosition] - 1;
@@ -251,6 +805,7 @@ void decodePlanarCode(unsigned short* code) {
                     fprintf(stderr, "MAXVAL too small: %d\n", MAXVAL);
                     exit(0);
                 }
+                checkNeighbour(i, code[codePosition]);
                 edges[edgeCounter].start = i;
                 edges[edgeCounter].end = code[codePosition] - 1;
                 edges[edgeCounter].prev = edges + edgeCounter - 1;
@@ -274,20 +829,41 @@ void decodePlanarCode(unsigned short* code) {
     ne = edgeCounter;
 }
 
+/* Returns the next byte of a code or header. Exits if the input ends there,
+ * instead of storing EOF in the code and reading on forever.
+ */
+static inline unsigned short readCodeByte(FILE *file){
+    int c = getc(file);
+    if (c == EOF) {
+        fprintf(stderr, "The input ends in the middle of a graph -- exiting!\n");
+        exit(1);
+    }
+    return c;
+}
+
 /**
- * 
- * @param code
+ * Reads the next code into *codePointer. The buffer is (re)allocated when
+ * it is too small for the code and *codeCapacity is updated accordingly.
+ *
+ * @param codePointer
+ * @param codeCapacity
  * @param length
  * @param file
  * @return returns 1 if a code was read and 0 otherwise. Exits in case of error.
  */
-int readPlanarCode(unsigned short code[], int *length, FILE *file) {
+int readPlanarCode(unsigned short **codePointer, int *codeCapacity, int *length, FILE *file) {
     static int first = 1;
     unsigned char c;
     char testheader[20];
     int bufferSize, zeroCounter;
     
     int readCount;
+    unsigned short *code;
+
+    if (*codeCapacity < CODELENGTH(maxn)) {
+        growCodeBuffer(codePointer, codeCapacity, CODELENGTH(maxn));
+    }
+    code = *codePointer;
 
 
     if (first) {
@@ -330,16 +906,16 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
         code[0] = c;
         bufferSize = 1;
         zeroCounter = 0;
-        code[1] = (unsigned short) getc(file);
+        code[1] = readCodeByte(file);
         if (code[1] == 0) zeroCounter++;
-        code[2] = (unsigned short) getc(file);
+        code[2] = readCodeByte(file);
         if (code[2] == 0) zeroCounter++;
         bufferSize = 3;
         // 3 characters were read and stored in buffer
         if ((code[1] == '>') && (code[2] == 'p')) /*we are sure that we're dealing with a header*/ {
-            while ((c = getc(file)) != '<');
+            while ((c = readCodeByte(file)) != '<');
             /* read 2 more characters: */
-            c = getc(file);
+            c = readCodeByte(file);
             if (c != '<') {
                 fprintf(stderr, "Problems with header -- single '<'\n");
                 exit(1);
@@ -359,12 +935,16 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
 
     if (c != 0) /* unsigned chars would be sufficient */ {
         code[0] = c;
-        if (code[0] > MAXN) {
-            fprintf(stderr, "Constant N too small %d > %d \n", code[0], MAXN);
-            exit(1);
+        if (*codeCapacity < CODELENGTH(code[0])) {
+            growCodeBuffer(codePointer, codeCapacity, CODELENGTH(code[0]));
+            code = *codePointer;
         }
         while (zeroCounter < code[0]) {
-            code[bufferSize] = (unsigned short) getc(file);
+            if (bufferSize == *codeCapacity) {
+                growCodeBuffer(codePointer, codeCapacity, 2 * *codeCapacity);
+                code = *codePointer;
+            }
+            code[bufferSize] = readCodeByte(file);
             if (code[bufferSize] == 0) zeroCounter++;
             bufferSize++;
         }
@@ -374,13 +954,17 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
             fprintf(stderr, "Unexpected EOF.\n");
             exit(1);
         }
-        if (code[0] > MAXN) {
-            fprintf(stderr, "Constant N too small %d > %d \n", code[0], MAXN);
-            exit(1);
+        if (*codeCapacity < CODELENGTH(code[0])) {
+            growCodeBuffer(codePointer, codeCapacity, CODELENGTH(code[0]));
+            code = *codePointer;
         }
         bufferSize = 1;
         zeroCounter = 0;
         while (zeroCounter < code[0]) {
+            if (bufferSize == *codeCapacity) {
+                growCodeBuffer(codePointer, codeCapacity, 2 * *codeCapacity);
+                code = *codePointer;
+            }
             readCount = fread(code + bufferSize, sizeof (unsigned short), 1, file);
             if(!readCount){
                 fprintf(stderr, "Unexpected EOF.\n");
@@ -397,21 +981,224 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
 
 }
 
+//=============== Sampling ===========================
+
+/* With --sample only a random part of the graphs is decoded: each graph is
+ * chosen independently with probability sampleProbability, or, for a
+ * stratified sample, exactly one graph is chosen at a random position in each
+ * block of 1/sampleProbability consecutive graphs. The other graphs are
+ * skipped by counting the zeros in their code. The same seed always chooses
+ * the same graphs.
+ */
+double sampleProbability = 0.0;
+boolean stratifiedSample = FALSE;
+unsigned long long sampleSeed = 0x5EED;
+int sampledGraphs = 0;
+int stratumSize;
+int chosenGraph; /* the graph that is chosen in the current stratum */
+
+static unsigned long long nextSampleRandom(void){
+    unsigned long long x = sampleSeed;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    sampleSeed = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/* Decides whether the graph with the given number (starting from 0) is part
+ * of the sample.
+ */
+boolean isSampled(int graph){
+    if(stratifiedSample){
+        if(graph % stratumSize == 0){
+            chosenGraph = graph + nextSampleRandom() % stratumSize;
+        }
+        return graph == chosenGraph;
+    }
+    return (nextSampleRandom() >> 11) * (1.0 / 9007199254740992.0) < sampleProbability;
+}
+
+/* Skips the next code in file without storing it. Returns FALSE if there are
+ * no more graphs. Headers and codes that might be headers are left to
+ * readPlanarCode.
+ */
+boolean skipPlanarCode(unsigned short **codePointer, int *codeCapacity, FILE *file){
+    int c, n, zeroCounter = 0;
+    unsigned short s;
+    int length;
+
+    if((c = getc_unlocked(file)) == EOF){
+        return FALSE;
+    }
+    if(numberOfGraphs == 0 || c == '>'){
+        ungetc(c, file);
+        return readPlanarCode(codePointer, codeCapacity, &length, file);
+    }
+    if(c != 0){
+        n = c;
+        while(zeroCounter < n){
+            if((c = getc_unlocked(file)) == EOF){
+                fprintf(stderr, "Unexpected EOF.\n");
+                exit(1);
+            }
+            if(c == 0) zeroCounter++;
+        }
+    } else {
+        if(!fread(&s, sizeof (unsigned short), 1, file)){
+            fprintf(stderr, "Unexpected EOF.\n");
+            exit(1);
+        }
+        n = s;
+        while(zeroCounter < n){
+            if(!fread(&s, sizeof (unsigned short), 1, file)){
+                fprintf(stderr, "Unexpected EOF.\n");
+                exit(1);
+            }
+            if(s == 0) zeroCounter++;
+        }
+    }
+    return TRUE;
+}
+
+/* Writes the estimated number of graphs for each partition, followed by a
+ * 95% confidence interval (the Wilson score interval for the fraction of the
+ * sampled graphs with that partition).
+ */
+void writeEstimates(){
+    const double z = 1.96;
+    int c;
+
+    for(c = 0; c < possiblePartitionCount; c++){
+        double estimate = 0.0, low = 0.0, high = 0.0;
+        if(sampledGraphs == numberOfGraphs){
+            estimate = low = high = partitionCount[c];
+        } else if(sampledGraphs){
+            double m = sampledGraphs;
+            double fraction = partitionCount[c] / m;
+            double centre = (fraction + z*z/(2*m)) / (1 + z*z/m);
+            double margin = z / (1 + z*z/m) * sqrt(fraction*(1 - fraction)/m + z*z/(4*m*m));
+            estimate = fraction * numberOfGraphs;
+            low = (centre - margin > 0 ? centre - margin : 0) * numberOfGraphs;
+            high = (centre + margin < 1 ? centre + margin : 1) * numberOfGraphs;
+        }
+        writePaddedInt((long long)(estimate + 0.5), 10);
+        writeString(" [");
+        writePaddedInt((long long)(low + 0.5), 10);
+        writeString(", ");
+        writePaddedInt((long long)(high + 0.5), 10);
+        writeString("] - ");
+        writePartition(c);
+    }
+}
+
+//=============== Parallel analysis ===========================
+
+/* The partitions of the graphs in the current batch. After each batch the
+ * worker adds its counts for these to the totals, so that progress reports
+ * include them.
+ */
+__thread int *batchPartitions;
+
+void initWorker(int worker){
+    if(partitionIndexFd >= 0){
+        outputBuffer.fd = partitionIndexFd;
+    } else if(featureFd >= 0){
+        outputBuffer.fd = featureFd;
+    }
+    initClusterStorage();
+    partitionCount = allocate(possiblePartitionCount, sizeof(int));
+    batchPartitions = allocate(BATCHGRAPHS, sizeof(int));
+}
+
+void analyseBatch(BATCH *batch){
+    int i;
+    for(i = 0; i < batch->count; i++){
+        startGraph();
+        decodePlanarCode(batch->codes + batch->codeStart[i]);
+        markStage(STAGE_DECODE);
+        checkPentagonCount();
+        batchPartitions[i] = identifyClusters();
+        markStage(STAGE_ANALYSIS);
+    }
+    for(i = 0; i < batch->count; i++){
+        int c = batchPartitions[i];
+        if(partitionCount[c]){
+            __atomic_add_fetch(partitionTotals + c, partitionCount[c], __ATOMIC_RELAXED);
+            partitionCount[c] = 0;
+        }
+    }
+    if(featureFd >= 0){
+        //each batch is a group of its own
+        writeFeatureRows();
+    }
+}
+
+void finishWorker(int worker){
+    free(partitionCount);
+    free(batchPartitions);
+}
+
+PARALLELANALYSIS parallelAnalysis = {initWorker, analyseBatch, finishWorker};
+
 //====================== USAGE =======================
 
 void help(char *name) {
-    fprintf(stderr, "The program %s counts the different partitions of twelve that\nappear as cluster sizes in the pentagonal adjacency graphs in the input.\n\n", name);
+    fprintf(stderr, "The program %s counts the different partitions of the number\nof pentagons that appear as cluster sizes in the pentagonal adjacency graphs in the input.\n\n", name);
     fprintf(stderr, "Usage\n=====\n");
-    fprintf(stderr, " %s [options]\n\n", name);
-    fprintf(stderr, "\nThis program can handle graphs up to %d vertices. Recompile if you need larger\n", MAXN);
-    fprintf(stderr, "graphs.\n\n");
+    fprintf(stderr, " %s [options] [file ...]\n\n", name);
+    fprintf(stderr, "\nThe graphs are read from the given files one after the other, or from\n");
+    fprintf(stderr, "standard in if no files are given.\n");
+    fprintf(stderr, "The storage for the graphs grows when larger graphs are read. Use the\n");
+    fprintf(stderr, "option --max-n to allocate it for a given number of vertices in advance.\n\n");
     fprintf(stderr, "Valid options\n=============\n");
     fprintf(stderr, "    -h, --help\n");
     fprintf(stderr, "       Print this help and return.\n");
+    fprintf(stderr, "    -P, --pentagons n\n");
+    fprintf(stderr, "       The number of pentagons in the structures, i.e., the number of vertices\n");
+    fprintf(stderr, "       in the pentagonal adjacency graphs. The default is 12 (fullerenes), use\n");
+    fprintf(stderr, "       6 for nanotube caps.\n");
+    fprintf(stderr, "    -m, --max-n n\n");
+    fprintf(stderr, "       Allocate the storage for graphs with up to n vertices at the start.\n");
+    fprintf(stderr, "    --stats[=file]\n");
+    fprintf(stderr, "       Write statistics about this run (time per stage, throughput and graph\n");
+    fprintf(stderr, "       sizes) in JSON to stderr or to the given file.\n");
+    fprintf(stderr, "    --progress seconds\n");
+    fprintf(stderr, "       Report the progress every given number of seconds. A report is also\n");
+    fprintf(stderr, "       written to stderr when the program receives SIGUSR1.\n");
+    fprintf(stderr, "    --async-input\n");
+    fprintf(stderr, "       Read the input on a separate thread, so reading and processing overlap.\n");
+    fprintf(stderr, "    -t, --threads n\n");
+    fprintf(stderr, "       Analyse the graphs on n threads. The default is 1.\n");
+    fprintf(stderr, "    -s, --sample p\n");
+    fprintf(stderr, "       Only analyse a random sample in which each graph is chosen with\n");
+    fprintf(stderr, "       probability p. For each partition the estimated number of graphs is\n");
+    fprintf(stderr, "       written, followed by a 95%% confidence interval. This option cannot be\n");
+    fprintf(stderr, "       combined with --threads.\n");
+    fprintf(stderr, "    --stratified\n");
+    fprintf(stderr, "       Choose exactly one graph at a random position in each block of 1/p\n");
+    fprintf(stderr, "       consecutive graphs instead of choosing each graph independently.\n");
+    fprintf(stderr, "    --seed seed\n");
+    fprintf(stderr, "       Use the given non-zero seed to choose the sample.\n");
+    fprintf(stderr, "    -i, --partition-index file\n");
+    fprintf(stderr, "       Also write the number of the partition of each graph to the given\n");
+    fprintf(stderr, "       file, which can be queried with cluster_server. This option cannot be\n");
+    fprintf(stderr, "       combined with --sample.\n");
+    fprintf(stderr, "    -f, --features file\n");
+    fprintf(stderr, "       Write a columnar file with for each graph its partition, its number of\n");
+    fprintf(stderr, "       edges, the size of its largest cluster, its number of clusters and\n");
+    fprintf(stderr, "       whether it has only valid clusters and whether it has a 6-cluster. This\n");
+    fprintf(stderr, "       option cannot be combined with --sample or --partition-index.\n");
+    fprintf(stderr, "    --cache[=directory]\n");
+    fprintf(stderr, "       Store the result in a cache (by default in %s), and write the\n", DEFAULTCACHEDIRECTORY);
+    fprintf(stderr, "       stored result instead of analysing the graphs when the input files\n");
+    fprintf(stderr, "       and the options that affect the result are the same as in an earlier\n");
+    fprintf(stderr, "       run. The input must be read from regular files. This option cannot be\n");
+    fprintf(stderr, "       combined with --partition-index or --features.\n");
 }
 
 void usage(char *name) {
-    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "Usage: %s [options] [file ...]\n", name);
     fprintf(stderr, "For more information type: %s -h \n\n", name);
 }
 
@@ -422,15 +1209,95 @@ int main(int argc, char *argv[]) {
     int c;
     char *name = argv[0];
     static struct option long_options[] = {
-        {"help", no_argument, NULL, 'h'}
+        {"help", no_argument, NULL, 'h'},
+        {"max-n", required_argument, NULL, 'm'},
+        {"stats", optional_argument, NULL, 'S'},
+        {"progress", required_argument, NULL, 'T'},
+        {"async-input", no_argument, NULL, 'A'},
+        {"threads", required_argument, NULL, 't'},
+        {"pentagons", required_argument, NULL, 'P'},
+        {"sample", required_argument, NULL, 's'},
+        {"stratified", no_argument, NULL, 'R'},
+        {"seed", required_argument, NULL, 'E'},
+        {"partition-index", required_argument, NULL, 'i'},
+        {"features", required_argument, NULL, 'f'},
+        {"cache", optional_argument, NULL, 'C'},
+        {NULL, 0, NULL, 0}
     };
     int option_index = 0;
+    int progressInterval = 0;
+    int threadCount = 1;
+    boolean asyncInput = FALSE;
+    char *partitionIndexName = NULL;
+    char *featureName = NULL;
+    char *cacheDirectory = NULL;
 
-    while ((c = getopt_long(argc, argv, "h", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "hm:P:t:s:i:f:", long_options, &option_index)) != -1) {
         switch (c) {
             case 'h':
                 help(name);
                 return EXIT_SUCCESS;
+            case 'm':
+                ensureCapacity(atoi(optarg));
+                break;
+            case 'P':
+                pentagonCount = atoi(optarg);
+                if(pentagonCount < 1){
+                    fprintf(stderr, "The number of pentagons should be positive.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'S':
+                initStats(optarg);
+                break;
+            case 't':
+                threadCount = atoi(optarg);
+                if(threadCount < 1){
+                    fprintf(stderr, "The number of threads should be positive.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                asyncInput = TRUE;
+                break;
+            case 's':
+                sampleProbability = atof(optarg);
+                if(sampleProbability <= 0 || sampleProbability > 1){
+                    fprintf(stderr, "The sampling probability should be in (0, 1].\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'R':
+                stratifiedSample = TRUE;
+                break;
+            case 'i':
+                partitionIndexName = optarg;
+                break;
+            case 'f':
+                featureName = optarg;
+                break;
+            case 'C':
+                cacheDirectory = optarg != NULL ? optarg : DEFAULTCACHEDIRECTORY;
+                break;
+            case 'E':
+                sampleSeed = strtoull(optarg, NULL, 0);
+                if(sampleSeed == 0){
+                    fprintf(stderr, "The seed should be non-zero.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'T':
+                progressInterval = atoi(optarg);
+                if(progressInterval < 1){
+                    fprintf(stderr, "The progress interval should be positive.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
             case '?':
                 usage(name);
                 return EXIT_FAILURE;
@@ -441,28 +1308,127 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    if(sampleProbability && threadCount > 1){
+        fprintf(stderr, "The option --sample cannot be combined with --threads.\n");
+        usage(name);
+        return EXIT_FAILURE;
+    }
+    if(sampleProbability && partitionIndexName != NULL){
+        fprintf(stderr, "The option --sample cannot be combined with --partition-index.\n");
+        usage(name);
+        return EXIT_FAILURE;
+    }
+    if(featureName != NULL && (sampleProbability || partitionIndexName != NULL)){
+        fprintf(stderr, "The option --features cannot be combined with --sample or --partition-index.\n");
+        usage(name);
+        return EXIT_FAILURE;
+    }
+    if(cacheDirectory != NULL && (partitionIndexName != NULL || featureName != NULL)){
+        fprintf(stderr, "The option --cache cannot be combined with --partition-index or --features.\n");
+        usage(name);
+        return EXIT_FAILURE;
+    }
+    if(stratifiedSample && !sampleProbability){
+        fprintf(stderr, "The option --stratified requires --sample.\n");
+        usage(name);
+        return EXIT_FAILURE;
+    }
+    stratumSize = sampleProbability ? (int)(1/sampleProbability + 0.5) : 1;
+
+    if(cacheDirectory != NULL){
+        //only the options that change the output are part of the key
+        char settings[256];
+        snprintf(settings, sizeof(settings), "count_all_clusters 1 pentagons=%d sample=%.17g stratified=%d seed=%llu",
+                pentagonCount, sampleProbability, stratifiedSample, sampleSeed);
+        if(lookupCachedResult(cacheDirectory, settings, argv + optind, argc - optind)){
+            return EXIT_SUCCESS;
+        }
+    }
+
     buildPartitions();
+    initClusterStorage();
+    if(partitionIndexName != NULL){
+        startPartitionIndex(partitionIndexName);
+    }
+    if(featureName != NULL){
+        startFeatures(featureName);
+    }
 
     /*=========== read planar graphs ===========*/
 
-    unsigned short code[MAXCODELENGTH];
-    int length;
-    while (readPlanarCode(code, &length, stdin)) {
-        decodePlanarCode(code);
-        if(nv!=12){
-            fprintf(stderr, "This program only supports pentagonal adjacency graphs of fullerenes -- exiting!\n");
-            return EXIT_FAILURE;
+    startProgress(&numberOfGraphs, progressInterval, reportPartitionCounts);
+    FILE *input = optind < argc ?
+            openInputFiles(argv + optind, argc - optind, asyncInput) : openInput(0, asyncInput);
+
+    if(threadCount > 1){
+        analyseInParallel(input, threadCount, &parallelAnalysis, &numberOfGraphs);
+    } else if(sampleProbability){
+        unsigned short *code = NULL;
+        int codeCapacity = 0;
+        int length;
+        while(1){
+            startGraph();
+            if(!isSampled(numberOfGraphs)){
+                if(!skipPlanarCode(&code, &codeCapacity, input)) break;
+                markStage(STAGE_READ);
+                numberOfGraphs++;
+                continue;
+            }
+            if(!readPlanarCode(&code, &codeCapacity, &length, input)) break;
+            markStage(STAGE_READ);
+            decodePlanarCode(code);
+            recordGraph(nv, ne, length);
+            markStage(STAGE_DECODE);
+            checkPentagonCount();
+            identifyClusters();
+            markStage(STAGE_ANALYSIS);
+            sampledGraphs++;
+            numberOfGraphs++;
+        }
+    } else {
+        unsigned short *code = NULL;
+        int codeCapacity = 0;
+        int length;
+        startGraph();
+        while (readPlanarCode(&code, &codeCapacity, &length, input)) {
+            markStage(STAGE_READ);
+            decodePlanarCode(code);
+            recordGraph(nv, ne, length);
+            markStage(STAGE_DECODE);
+            checkPentagonCount();
+            identifyClusters();
+            markStage(STAGE_ANALYSIS);
+            numberOfGraphs++;
+            startGraph();
         }
-        identifyClusters();
-        numberOfGraphs++;
     }
     
-    for(c = 0; c < possiblePartitionCount; c++){
-        fprintf(stdout, "%8d - ", partitionCount[c]);
-        printPartition(stdout, c, TRUE);
+    if(partitionIndexFd >= 0){
+        finishPartitionIndex();
+    }
+    if(featureFd >= 0){
+        finishFeatures();
+    }
+
+    startSection();
+    if(sampleProbability){
+        writeEstimates();
+    } else {
+        for(c = 0; c < possiblePartitionCount; c++){
+            writePaddedInt(partitionCount[c], 8);
+            writeString(" - ");
+            writePartition(c);
+        }
     }
+    flushOutput();
+    markStage(STAGE_OUTPUT);
     
-    fprintf(stderr, "Read %d graph%s.\n", numberOfGraphs, numberOfGraphs==1 ? "" : "s");
+    writeSummary("Read %d graph%s.\n", numberOfGraphs, numberOfGraphs==1 ? "" : "s");
+    if(sampleProbability){
+        writeSummary("Analysed a sample of %d graph%s.\n", sampledGraphs, sampledGraphs==1 ? "" : "s");
+    }
+    storeCachedResult();
+    finishStats();
     
     return EXIT_SUCCESS;
 }
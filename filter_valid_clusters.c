@@ -6,12 +6,13 @@
  */
 
 /* This program reads pentagonal adjacency graphs of fullerenes from standard in
- * and searches for specific clusters of pentagons.   
+ * (or nanotube caps, see --pentagons) and searches for specific clusters of
+ * pentagons.   
  * 
  * 
  * Compile with:
  *     
- *     cc -o filter_valid_clusters -O4 filter_valid_clusters.c
+ *     cc -o filter_valid_clusters -O4 filter_valid_clusters.c output.c stats.c progress.c input.c parallel.c cache.c -pthread -lz -llzma
  * 
  */
 
@@ -20,13 +21,20 @@
 #include <getopt.h>
 #include <string.h>
 
+#include "output.h"
+#include "stats.h"
+#include "progress.h"
+#include "input.h"
+#include "parallel.h"
+#include "cache.h"
+
 
 #ifndef MAXN
-#define MAXN 12            /* the maximum number of vertices */
+#define MAXN 12            /* the initial maximum number of vertices */
 #endif
-#define MAXE (6*MAXN-12)    /* the maximum number of oriented edges */
-#define MAXVAL (MAXN-1)  /* the maximum degree of a vertex */
-#define MAXCODELENGTH (MAXN+MAXE+3)
+#define EDGECOUNT(n) (6*(n)-12)    /* the maximum number of oriented edges */
+#define MAXVAL (maxn-1)  /* the maximum degree of a vertex */
+#define CODELENGTH(n) ((n)+EDGECOUNT(n)+3)
 
 #define FALSE 0
 #define TRUE  1
@@ -43,48 +51,207 @@ typedef struct e /* The data type used for edges */ {
     
 } EDGE;
 
-EDGE *firstedge[MAXN]; /* pointer to arbitrary edge out of vertex i. */
-int degree[MAXN];
+/* The storage for the graphs is sized at runtime. The static arrays are used
+ * as long as the graphs have at most MAXN vertices. Once a larger graph is read
+ * (or a larger size is requested with --max-n) the storage moves to the heap,
+ * where it is reused for all later graphs. Each thread has its own storage,
+ * which is attached on the first call to ensureCapacity.
+ */
+__thread int maxn = MAXN; /* the number of vertices for which storage is available */
+
+__thread EDGE *firstedgeStorage[MAXN];
+__thread int degreeStorage[MAXN];
+__thread EDGE edgesStorage[EDGECOUNT(MAXN)];
 
-EDGE edges[MAXE];
+__thread EDGE **firstedge = NULL; /* pointer to arbitrary edge out of vertex i. */
+__thread int *degree = NULL;
+
+__thread EDGE *edges = NULL;
 
 int numberOfGraphs = 0;
 int numberOfValid = 0;
 
-int nv;
-int ne;
+__thread int nv;
+__thread int ne;
 
-/* Below we list how many clusters of a given size are possible in a fullerene.
+/* The number of pentagons, i.e., the number of vertices in each pentagonal
+ * adjacency graph. This is 12 for fullerenes and 6 for nanotube caps.
+ */
+int pentagonCount = 12;
+
+/* The number of graphs with only valid clusters is counted per combination of
+ * the number of clusters of each size. There are at most pentagonCount/s
+ * clusters of size s, so for fullerenes we get the following ranges.
  * 
  * 1: 0 - 12
  * 2: 0 -  6
  * 3: 0 -  4
  * 4: 0 -  3
  * 5: 0 -  2
+ *
+ * The key of a combination is a number in which the number of clusters of
+ * size s has weight clusterWeight[s-1]. Only the combinations in which the
+ * sizes add up to pentagonCount can occur, so these are numbered in
+ * increasing order of their keys and the tables are indexed by that number.
+ * As long as the product of the bases is at most MAXDIRECTTABLESIZE, the
+ * number of a key is looked up directly in partitions2Number. Otherwise it is
+ * found by binary search in partitionKeys. These lookup tables are shared by
+ * all threads; each thread only has its own partitions and firstRanks. The
+ * table firstRanks holds the rank of the first graph with each combination (0
+ * if there is none).
  */
-int partitions[13][7][5][4][3];
+#define MAXDIRECTTABLESIZE (1<<22)
+
+typedef unsigned long long PARTITIONKEY;
+
+__thread int *partitions;
+int *partitionTotals; /* the table of the main thread, which holds the totals */
+__thread int *firstRanks;
+int *firstRankTotals;
+__thread int currentRank; /* the rank of the graph that is analysed */
+__thread int currentPartition; /* the combination of the last valid graph */
+PARTITIONKEY clusterWeight[5];
+PARTITIONKEY partitionKeyRange; /* the product of the bases */
+int *partitions2Number = NULL;
+PARTITIONKEY *partitionKeys; /* the key of each combination, in increasing order */
+int partitionsSize; /* the number of combinations */
+
+void *allocate(size_t count, size_t size){
+    void *storage = calloc(count, size);
+    if(storage == NULL){
+        fprintf(stderr, "Insufficient memory for the partition tables -- exiting!\n");
+        exit(1);
+    }
+    return storage;
+}
 
-//=============== Checking for property ===========================
+void buildPartitionTable(){
+    int i, j, k, l, m, pass;
+    partitionKeyRange = 1;
+    for(i = 0; i < 5; i++){
+        clusterWeight[i] = partitionKeyRange;
+        if(partitionKeyRange > ~0ULL / (pentagonCount/(i+1) + 1)){
+            fprintf(stderr, "Partitions of %d are not supported -- exiting!\n", pentagonCount);
+            exit(1);
+        }
+        partitionKeyRange *= pentagonCount/(i+1) + 1;
+    }
 
-int currentPartition[5];
+    //the first pass counts the combinations, the second one stores their keys
+    for(pass = 0; pass < 2; pass++){
+        partitionsSize = 0;
+        for(m = 0; 5*m <= pentagonCount; m++){
+            for(l = 0; 5*m + 4*l <= pentagonCount; l++){
+                for(k = 0; 5*m + 4*l + 3*k <= pentagonCount; k++){
+                    for(j = 0; 5*m + 4*l + 3*k + 2*j <= pentagonCount; j++){
+                        if(pass){
+                            i = pentagonCount - 5*m - 4*l - 3*k - 2*j;
+                            partitionKeys[partitionsSize] = i*clusterWeight[0] + j*clusterWeight[1] +
+                                    k*clusterWeight[2] + l*clusterWeight[3] + m*clusterWeight[4];
+                        }
+                        partitionsSize++;
+                    }
+                }
+            }
+        }
+        if(!pass){
+            partitionKeys = allocate(partitionsSize, sizeof(PARTITIONKEY));
+        }
+    }
+    if(partitionKeyRange <= MAXDIRECTTABLESIZE){
+        partitions2Number = allocate(partitionKeyRange, sizeof(int));
+        for(i = 0; i < partitionsSize; i++){
+            partitions2Number[partitionKeys[i]] = i;
+        }
+    }
 
-boolean visited[12];
-boolean currentCluster[12];
-int currentClusterSize;
+    partitions = allocate(partitionsSize, sizeof(int));
+    partitionTotals = partitions;
+    firstRanks = allocate(partitionsSize, sizeof(int));
+    firstRankTotals = firstRanks;
+}
 
-boolean validateCurrentCluster(){
-    if(currentClusterSize < 3) return TRUE;
-    if(currentClusterSize > 5) return FALSE;
+/* Returns the number of the combination with the given key. */
+static inline int getPartitionNumber(PARTITIONKEY key){
+    if(partitions2Number != NULL){
+        return partitions2Number[key];
+    }
+    int low = 0, high = partitionsSize - 1;
+    while(low < high){
+        int middle = (low + high)/2;
+        if(partitionKeys[middle] < key){
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/* Writes the counts that were found so far for a progress report. */
+void reportValidClusterCounts(FILE *f){
+    int index, i;
+    int valid = __atomic_load_n(&numberOfValid, __ATOMIC_RELAXED);
     
-    //build degree frequency table
-    int degreeFreqTable[5];
-    int i;
-    for(i = 0; i < 5; i++) degreeFreqTable[i] = 0;
-    for(i = 0; i < 12; i++){
-        if(currentCluster[i]){
-            degreeFreqTable[degree[i]]++;
+    fprintf(f, "Found %d valid cluster%s so far.\n", valid, valid==1 ? "" : "s");
+    for(index = 0; index < partitionsSize; index++){
+        int count = __atomic_load_n(partitionTotals + index, __ATOMIC_RELAXED);
+        if(count){
+            for(i = 0; i < 5; i++){
+                fprintf(f, i ? ",%d" : "%d",
+                        (int)(partitionKeys[index] / clusterWeight[i] % (pentagonCount/(i+1) + 1)));
+            }
+            fprintf(f, ": %d\n", count);
         }
     }
+}
+
+//=============== Checking for property ===========================
+
+__thread boolean *visited;
+__thread int *stack;
+__thread int currentClusterSize;
+__thread int degreeFreqTable[5];
+
+/* Below we list the number of edges in each valid cluster. A cluster with
+ * three or more pentagons is only valid if it has exactly this number of
+ * edges, so a valid graph has at most as many edges as the best way to
+ * split its vertices into clusters of at most five pentagons.
+ */
+int validClusterEdges[6] = {0, 0, 1, 3, 5, 7};
+
+/* The maximum degree sum (i.e., twice the number of edges) of a graph with
+ * i vertices that only contains valid clusters. Graphs with a larger degree
+ * sum are rejected before any cluster is built.
+ */
+int *maxValidDegreeSum;
+
+void buildDegreeSumBounds(){
+    int i, size;
+    maxValidDegreeSum = allocate(pentagonCount + 1, sizeof(int));
+    maxValidDegreeSum[0] = 0;
+    for(i = 1; i <= pentagonCount; i++){
+        maxValidDegreeSum[i] = 0;
+        for(size = 1; size <= 5 && size <= i; size++){
+            int bound = maxValidDegreeSum[i - size] + 2*validClusterEdges[size];
+            if(bound > maxValidDegreeSum[i]){
+                maxValidDegreeSum[i] = bound;
+            }
+        }
+    }
+}
+
+void initClusterStorage(){
+    visited = allocate(pentagonCount, sizeof(boolean));
+    stack = allocate(pentagonCount, sizeof(int));
+}
+
+/* Validates the cluster that was just completed. The degree frequency table
+ * is built while the cluster grows, so no extra pass over the vertices is
+ * needed.
+ */
+boolean validateCurrentCluster(){
+    if(currentClusterSize < 3) return TRUE;
     
     if(currentClusterSize == 3) return degreeFreqTable[2] == 3;
     if(currentClusterSize == 4) return degreeFreqTable[2] == 2 && degreeFreqTable[3] == 2;
@@ -94,35 +261,49 @@ boolean validateCurrentCluster(){
     return FALSE;
 }
 
+/* Adds vertex v to the current cluster and checks the constraints that can
+ * already be verified while the cluster grows. Returns FALSE as soon as the
+ * cluster can no longer be valid.
+ */
+#define ADDTOCLUSTER(v) {\
+    if(degree[v] > 4) return FALSE;\
+    degreeFreqTable[degree[v]]++;\
+    if(++currentClusterSize > 5) return FALSE;\
+    if(currentClusterSize >= 3 && (degreeFreqTable[0] || degreeFreqTable[1])) return FALSE;\
+}
+
 //some macros for the stack in the next method
 #define PUSH(stack, value) stack[top++] = (value)
 #define POP(stack) stack[--top]
 #define STACKISEMPTY top==0
 #define STACKISNOTEMPTY top>0
 
-boolean hasValidClusters(){
+/* The body of hasValidClusters for graphs with n vertices. This function is
+ * inlined with a constant n for the pentagonal adjacency graphs of fullerenes,
+ * so that case gets its own specialised copy.
+ */
+static inline boolean hasValidClustersOfOrder(int n){
     int i, j, top, currentVertex;
-    int stack[12];
+    PARTITIONKEY partitionKey = 0;
     
-    for(i = 0; i < 12; i++){
-        visited[i] = FALSE;
-    }
+    if(ne > maxValidDegreeSum[n]) return FALSE;
     
-    for(i = 0; i < 5; i++){
-        currentPartition[i] = 0;
+    for(i = 0; i < n; i++){
+        visited[i] = FALSE;
     }
     
-    for(i = 0; i < nv; i++){
+    for(i = 0; i < n; i++){
         if(!visited[i]){
-            for(j = 0; j < 12; j++){
-                currentCluster[j] = FALSE;
+            for(j = 0; j < 5; j++){
+                degreeFreqTable[j] = 0;
             }
             
             //build cluster containing vertex i
             top = 0;
             PUSH(stack, i);
-            visited[i] = currentCluster[i] = TRUE;
-            currentClusterSize = 1;
+            visited[i] = TRUE;
+            currentClusterSize = 0;
+            ADDTOCLUSTER(i);
             while(STACKISNOTEMPTY){
                 currentVertex = POP(stack);
                 if(degree[currentVertex]){
@@ -132,8 +313,8 @@ boolean hasValidClusters(){
                     do {
                         if (!visited[e->end]) {
                             PUSH(stack, e->end);
-                            visited[e->end] = currentCluster[e->end] = TRUE;
-                            currentClusterSize++;
+                            visited[e->end] = TRUE;
+                            ADDTOCLUSTER(e->end);
                         }
                         e = e->next;
                     } while (e != elast);
@@ -143,15 +324,85 @@ boolean hasValidClusters(){
             //validate cluster
             if(!validateCurrentCluster()) return FALSE;
             
-            currentPartition[currentClusterSize-1]++;
+            partitionKey += clusterWeight[currentClusterSize-1];
         }
     }
     
-    partitions[currentPartition[0]][currentPartition[1]][currentPartition[2]][currentPartition[3]][currentPartition[4]]++;
+    int partitionIndex = getPartitionNumber(partitionKey);
+    partitions[partitionIndex]++;
+    //the batches of a worker are not always consecutive
+    if(!firstRanks[partitionIndex] || currentRank < firstRanks[partitionIndex]){
+        firstRanks[partitionIndex] = currentRank;
+    }
+    currentPartition = partitionIndex;
     
     return TRUE;
 }
 
+boolean hasValidClusters(){
+    if(nv == 12){
+        return hasValidClustersOfOrder(12);
+    }
+    return hasValidClustersOfOrder(nv);
+}
+
+void checkPentagonCount(){
+    if(nv!=pentagonCount){
+        fprintf(stderr, "Read a graph with %d vertices while expecting pentagonal adjacency graphs\n", nv);
+        fprintf(stderr, "with %d vertices (use --pentagons to change this) -- exiting!\n", pentagonCount);
+        exit(1);
+    }
+}
+
+//=============== Graph storage ===========================
+
+/* Returns storage for count elements of the given size to replace current.
+ * The contents are not preserved. The initial storage is the static array,
+ * which is never freed.
+ */
+void *resizeStorage(void *current, void *initial, size_t count, size_t size){
+    if(current != initial){
+        free(current);
+    }
+    void *storage = malloc(count * size);
+    if(storage == NULL){
+        fprintf(stderr, "Insufficient memory for the graph storage -- exiting!\n");
+        exit(1);
+    }
+    return storage;
+}
+
+/* Makes sure that graphs with n vertices fit in the graph storage. The storage
+ * grows by at least half of its size to avoid repeated resizing when the
+ * graphs grow gradually.
+ */
+void ensureCapacity(int n){
+    if(firstedge == NULL){
+        //each thread starts with its own static storage
+        firstedge = firstedgeStorage;
+        degree = degreeStorage;
+        edges = edgesStorage;
+    }
+    if(n <= maxn) return;
+    if(n < maxn + maxn/2){
+        n = maxn + maxn/2;
+    }
+    firstedge = resizeStorage(firstedge, firstedgeStorage, n, sizeof(EDGE *));
+    degree = resizeStorage(degree, degreeStorage, n, sizeof(int));
+    edges = resizeStorage(edges, edgesStorage, EDGECOUNT(n), sizeof(EDGE));
+    maxn = n;
+}
+
+void growCodeBuffer(unsigned short **code, int *capacity, int newCapacity){
+    unsigned short *buffer = realloc(*code, newCapacity * sizeof(unsigned short));
+    if(buffer == NULL){
+        fprintf(stderr, "Insufficient memory for a code of length %d -- exiting!\n", newCapacity);
+        exit(1);
+    }
+    *code = buffer;
+    *capacity = newCapacity;
+}
+
 //=============== Reading and decoding planarcode ===========================
 
 EDGE *findEdge(int from, int to) {
@@ -178,6 +429,8 @@ void decodePlanarCode(unsigned short* code) {
     nv = code[0];
     codePosition = 1;
 
+    ensureCapacity(nv);
+
     for (i = 0; i < nv; i++) {
         degree[i] = 0;
         if(code[codePosition]){
@@ -222,20 +475,41 @@ void decodePlanarCode(unsigned short* code) {
     ne = edgeCounter;
 }
 
+/* Returns the next byte of a code or header. Exits if the input ends there,
+ * instead of storing EOF in the code and reading on forever.
+ */
+static inline unsigned short readCodeByte(FILE *file){
+    int c = getc(file);
+    if (c == EOF) {
+        fprintf(stderr, "The input ends in the middle of a graph -- exiting!\n");
+        exit(1);
+    }
+    return c;
+}
+
 /**
- * 
- * @param code
+ * Reads the next code into *codePointer. The buffer is (re)allocated when
+ * it is too small for the code and *codeCapacity is updated accordingly.
+ *
+ * @param codePointer
+ * @param codeCapacity
  * @param length
  * @param file
  * @return returns 1 if a code was read and 0 otherwise. Exits in case of error.
  */
-int readPlanarCode(unsigned short code[], int *length, FILE *file) {
+int readPlanarCode(unsigned short **codePointer, int *codeCapacity, int *length, FILE *file) {
     static int first = 1;
     unsigned char c;
     char testheader[20];
     int bufferSize, zeroCounter;
     
     int readCount;
+    unsigned short *code;
+
+    if (*codeCapacity < CODELENGTH(maxn)) {
+        growCodeBuffer(codePointer, codeCapacity, CODELENGTH(maxn));
+    }
+    code = *codePointer;
 
 
     if (first) {
@@ -278,16 +552,16 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
         code[0] = c;
         bufferSize = 1;
         zeroCounter = 0;
-        code[1] = (unsigned short) getc(file);
+        code[1] = readCodeByte(file);
         if (code[1] == 0) zeroCounter++;
-        code[2] = (unsigned short) getc(file);
+        code[2] = readCodeByte(file);
         if (code[2] == 0) zeroCounter++;
         bufferSize = 3;
         // 3 characters were read and stored in buffer
         if ((code[1] == '>') && (code[2] == 'p')) /*we are sure that we're dealing with a header*/ {
-            while ((c = getc(file)) != '<');
+            while ((c = readCodeByte(file)) != '<');
             /* read 2 more characters: */
-            c = getc(file);
+            c = readCodeByte(file);
             if (c != '<') {
                 fprintf(stderr, "Problems with header -- single '<'\n");
                 exit(1);
@@ -307,12 +581,16 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
 
     if (c != 0) /* unsigned chars would be sufficient */ {
         code[0] = c;
-        if (code[0] > MAXN) {
-            fprintf(stderr, "Constant N too small %d > %d \n", code[0], MAXN);
-            exit(1);
+        if (*codeCapacity < CODELENGTH(code[0])) {
+            growCodeBuffer(codePointer, codeCapacity, CODELENGTH(code[0]));
+            code = *codePointer;
         }
         while (zeroCounter < code[0]) {
-            code[bufferSize] = (unsigned short) getc(file);
+            if (bufferSize == *codeCapacity) {
+                growCodeBuffer(codePointer, codeCapacity, 2 * *codeCapacity);
+                code = *codePointer;
+            }
+            code[bufferSize] = readCodeByte(file);
             if (code[bufferSize] == 0) zeroCounter++;
             bufferSize++;
         }
@@ -322,13 +600,17 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
             fprintf(stderr, "Unexpected EOF.\n");
             exit(1);
         }
-        if (code[0] > MAXN) {
-            fprintf(stderr, "Constant N too small %d > %d \n", code[0], MAXN);
-            exit(1);
+        if (*codeCapacity < CODELENGTH(code[0])) {
+            growCodeBuffer(codePointer, codeCapacity, CODELENGTH(code[0]));
+            code = *codePointer;
         }
         bufferSize = 1;
         zeroCounter = 0;
         while (zeroCounter < code[0]) {
+            if (bufferSize == *codeCapacity) {
+                growCodeBuffer(codePointer, codeCapacity, 2 * *codeCapacity);
+                code = *codePointer;
+            }
             readCount = fread(code + bufferSize, sizeof (unsigned short), 1, file);
             if(!readCount){
                 fprintf(stderr, "Unexpected EOF.\n");
@@ -345,23 +627,101 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
 
 }
 
+//=============== Parallel analysis ===========================
+
+/* The combinations of the valid graphs in the current batch. After each batch
+ * the worker adds its counts for these to the totals, so that progress
+ * reports include them.
+ */
+__thread int *batchPartitions;
+
+void initWorker(int worker){
+    initClusterStorage();
+    partitions = allocate(partitionsSize, sizeof(int));
+    firstRanks = allocate(partitionsSize, sizeof(int));
+    batchPartitions = allocate(BATCHGRAPHS, sizeof(int));
+}
+
+void analyseBatch(BATCH *batch){
+    int i, valid = 0;
+    for(i = 0; i < batch->count; i++){
+        startGraph();
+        currentRank = batch->firstGraph + i + 1;
+        decodePlanarCode(batch->codes + batch->codeStart[i]);
+        markStage(STAGE_DECODE);
+        checkPentagonCount();
+        if(hasValidClusters()){
+            batchPartitions[valid++] = currentPartition;
+        }
+        markStage(STAGE_ANALYSIS);
+    }
+    for(i = 0; i < valid; i++){
+        int index = batchPartitions[i];
+        if(partitions[index]){
+            __atomic_add_fetch(partitionTotals + index, partitions[index], __ATOMIC_RELAXED);
+            partitions[index] = 0;
+        }
+    }
+    __atomic_add_fetch(&numberOfValid, valid, __ATOMIC_RELAXED);
+}
+
+void finishWorker(int worker){
+    int i;
+    for(i = 0; i < partitionsSize; i++){
+        if(firstRanks[i] && (!firstRankTotals[i] || firstRanks[i] < firstRankTotals[i])){
+            firstRankTotals[i] = firstRanks[i];
+        }
+    }
+    free(partitions);
+    free(batchPartitions);
+    free(firstRanks);
+}
+
+PARALLELANALYSIS parallelAnalysis = {initWorker, analyseBatch, finishWorker};
+
 //====================== USAGE =======================
 
 void help(char *name) {
     fprintf(stderr, "The program %s reads pentagonal adjacency graphs of\nfullerenes and searches them for specific clusters.\n\n", name);
     fprintf(stderr, "Usage\n=====\n");
-    fprintf(stderr, " %s [options]\n\n", name);
-    fprintf(stderr, "\nThis program can handle graphs up to %d vertices. Recompile if you need larger\n", MAXN);
-    fprintf(stderr, "graphs.\n\n");
+    fprintf(stderr, " %s [options] [file ...]\n\n", name);
+    fprintf(stderr, "\nThe graphs are read from the given files one after the other, or from\n");
+    fprintf(stderr, "standard in if no files are given.\n");
+    fprintf(stderr, "The storage for the graphs grows when larger graphs are read. Use the\n");
+    fprintf(stderr, "option --max-n to allocate it for a given number of vertices in advance.\n\n");
     fprintf(stderr, "Valid options\n=============\n");
     fprintf(stderr, "    -c, --count\n");
     fprintf(stderr, "       Print the number of times a partition appears.\n");
+    fprintf(stderr, "    -r, --first-rank\n");
+    fprintf(stderr, "       Also print the rank of the first graph in which a partition appears.\n");
+    fprintf(stderr, "       This implies --count.\n");
     fprintf(stderr, "    -h, --help\n");
     fprintf(stderr, "       Print this help and return.\n");
+    fprintf(stderr, "    -P, --pentagons n\n");
+    fprintf(stderr, "       The number of pentagons in the structures, i.e., the number of vertices\n");
+    fprintf(stderr, "       in the pentagonal adjacency graphs. The default is 12 (fullerenes), use\n");
+    fprintf(stderr, "       6 for nanotube caps.\n");
+    fprintf(stderr, "    -m, --max-n n\n");
+    fprintf(stderr, "       Allocate the storage for graphs with up to n vertices at the start.\n");
+    fprintf(stderr, "    --stats[=file]\n");
+    fprintf(stderr, "       Write statistics about this run (time per stage, throughput and graph\n");
+    fprintf(stderr, "       sizes) in JSON to stderr or to the given file.\n");
+    fprintf(stderr, "    --progress seconds\n");
+    fprintf(stderr, "       Report the progress every given number of seconds. A report is also\n");
+    fprintf(stderr, "       written to stderr when the program receives SIGUSR1.\n");
+    fprintf(stderr, "    --async-input\n");
+    fprintf(stderr, "       Read the input on a separate thread, so reading and processing overlap.\n");
+    fprintf(stderr, "    -t, --threads n\n");
+    fprintf(stderr, "       Analyse the graphs on n threads. The default is 1.\n");
+    fprintf(stderr, "    --cache[=directory]\n");
+    fprintf(stderr, "       Store the result in a cache (by default in %s), and write the\n", DEFAULTCACHEDIRECTORY);
+    fprintf(stderr, "       stored result instead of analysing the graphs when the input files\n");
+    fprintf(stderr, "       and the options that affect the result are the same as in an earlier\n");
+    fprintf(stderr, "       run. The input must be read from regular files.\n");
 }
 
 void usage(char *name) {
-    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "Usage: %s [options] [file ...]\n", name);
     fprintf(stderr, "For more information type: %s -h \n\n", name);
 }
 
@@ -370,25 +730,78 @@ int main(int argc, char *argv[]) {
     /*=========== commandline parsing ===========*/
     
     boolean printCounts = FALSE;
+    boolean printFirstRanks = FALSE;
 
     int c;
     char *name = argv[0];
     static struct option long_options[] = {
         {"count", no_argument, NULL, 'c'},
-        {"help", no_argument, NULL, 'h'}
+        {"first-rank", no_argument, NULL, 'r'},
+        {"help", no_argument, NULL, 'h'},
+        {"max-n", required_argument, NULL, 'm'},
+        {"stats", optional_argument, NULL, 'S'},
+        {"progress", required_argument, NULL, 'T'},
+        {"async-input", no_argument, NULL, 'A'},
+        {"threads", required_argument, NULL, 't'},
+        {"pentagons", required_argument, NULL, 'P'},
+        {"cache", optional_argument, NULL, 'C'},
+        {NULL, 0, NULL, 0}
     };
     int option_index = 0;
+    int progressInterval = 0;
+    int threadCount = 1;
+    boolean asyncInput = FALSE;
+    char *cacheDirectory = NULL;
 
-    while ((c = getopt_long(argc, argv, "hc", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "hcrm:P:t:", long_options, &option_index)) != -1) {
         switch (c) {
             case 0:
                 break;
             case 'c':
                 printCounts = TRUE;
                 break;
+            case 'r':
+                printCounts = printFirstRanks = TRUE;
+                break;
             case 'h':
                 help(name);
                 return EXIT_SUCCESS;
+            case 'm':
+                ensureCapacity(atoi(optarg));
+                break;
+            case 'P':
+                pentagonCount = atoi(optarg);
+                if(pentagonCount < 1){
+                    fprintf(stderr, "The number of pentagons should be positive.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'S':
+                initStats(optarg);
+                break;
+            case 't':
+                threadCount = atoi(optarg);
+                if(threadCount < 1){
+                    fprintf(stderr, "The number of threads should be positive.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                asyncInput = TRUE;
+                break;
+            case 'C':
+                cacheDirectory = optarg != NULL ? optarg : DEFAULTCACHEDIRECTORY;
+                break;
+            case 'T':
+                progressInterval = atoi(optarg);
+                if(progressInterval < 1){
+                    fprintf(stderr, "The progress interval should be positive.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
             case '?':
                 usage(name);
                 return EXIT_FAILURE;
@@ -399,46 +812,81 @@ int main(int argc, char *argv[]) {
         }
     }
     
-    int i, j, k, l, m;
-    for(m=2; m>=0; m--){
-        for(l=3; l>=0; l--){
-            for(k=4; k>=0; k--){
-                for(j=6; j>=0; j--){
-                    for(i=0; i<13; i++){
-                        partitions[i][j][k][l][m] = 0;
-                    }
-                }
-            }
+    if(cacheDirectory != NULL){
+        //only the options that change the output are part of the key
+        char settings[256];
+        snprintf(settings, sizeof(settings), "filter_valid_clusters 1 pentagons=%d count=%d first-rank=%d",
+                pentagonCount, printCounts, printFirstRanks);
+        if(lookupCachedResult(cacheDirectory, settings, argv + optind, argc - optind)){
+            return EXIT_SUCCESS;
         }
     }
 
+    buildPartitionTable();
+    buildDegreeSumBounds();
+    initClusterStorage();
+    
+    int i, j, k, l, m;
+
     /*=========== read pentagonal adjacency graphs ===========*/
 
-    unsigned short code[MAXCODELENGTH];
-    int length;
-    while (readPlanarCode(code, &length, stdin)) {
-        decodePlanarCode(code);
-        if(nv!=12){
-            fprintf(stderr, "This program only supports pentagonal adjacency graphs of fullerenes -- exiting!\n");
-            return EXIT_FAILURE;
-        }
-        if(hasValidClusters()){
-            numberOfValid++;
+    startProgress(&numberOfGraphs, progressInterval, reportValidClusterCounts);
+    FILE *input = optind < argc ?
+            openInputFiles(argv + optind, argc - optind, asyncInput) : openInput(0, asyncInput);
+
+    if(threadCount > 1){
+        analyseInParallel(input, threadCount, &parallelAnalysis, &numberOfGraphs);
+    } else {
+        unsigned short *code = NULL;
+        int codeCapacity = 0;
+        int length;
+        startGraph();
+        while (readPlanarCode(&code, &codeCapacity, &length, input)) {
+            markStage(STAGE_READ);
+            currentRank = numberOfGraphs + 1;
+            decodePlanarCode(code);
+            recordGraph(nv, ne, length);
+            markStage(STAGE_DECODE);
+            checkPentagonCount();
+            if(hasValidClusters()){
+                numberOfValid++;
+            }
+            markStage(STAGE_ANALYSIS);
+            numberOfGraphs++;
+            startGraph();
         }
-        numberOfGraphs++;
     }
     
-    for(m=2; m>=0; m--){
-        for(l=3; l>=0; l--){
-            for(k=4; k>=0; k--){
-                for(j=6; j>=0; j--){
-                    for(i=0; i<13; i++){
-                        if(partitions[i][j][k][l][m]){
+    startSection();
+    for(m=pentagonCount/5; m>=0; m--){
+        for(l=pentagonCount/4; l>=0; l--){
+            for(k=pentagonCount/3; k>=0; k--){
+                for(j=pentagonCount/2; j>=0; j--){
+                    //only one number of 1-clusters completes the combination
+                    i = pentagonCount - 2*j - 3*k - 4*l - 5*m;
+                    if(i >= 0){
+                        int index = getPartitionNumber(i*clusterWeight[0] + j*clusterWeight[1] +
+                                k*clusterWeight[2] + l*clusterWeight[3] + m*clusterWeight[4]);
+                        int count = partitions[index];
+                        if(count){
+                            writeInt(i);
+                            writeByte(',');
+                            writeInt(j);
+                            writeByte(',');
+                            writeInt(k);
+                            writeByte(',');
+                            writeInt(l);
+                            writeByte(',');
+                            writeInt(m);
                             if(printCounts){
-                                fprintf(stdout, "%d,%d,%d,%d,%d: %d\n", i, j, k, l, m, partitions[i][j][k][l][m]);
-                            } else {
-                                fprintf(stdout, "%d,%d,%d,%d,%d\n", i, j, k, l, m);
+                                writeString(": ");
+                                writeInt(count);
                             }
+                            if(printFirstRanks){
+                                writeByte(' ');
+                                writeInt(firstRanks[index]);
+                            }
+                            writeByte('\n');
                         }
                     }
                 }
@@ -446,9 +894,14 @@ int main(int argc, char *argv[]) {
         }
     }
     
-    fprintf(stderr, "Read %d graph%s.\n", numberOfGraphs, numberOfGraphs==1 ? "" : "s");
-    fprintf(stderr, "Found %d valid cluster%s.\n", numberOfValid, 
+    flushOutput();
+    markStage(STAGE_OUTPUT);
+    
+    writeSummary("Read %d graph%s.\n", numberOfGraphs, numberOfGraphs==1 ? "" : "s");
+    writeSummary("Found %d valid cluster%s.\n", numberOfValid, 
                 numberOfValid==1 ? "" : "s");
+    storeCachedResult();
+    finishStats();
     
     return EXIT_SUCCESS;
 }
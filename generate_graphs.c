@@ -0,0 +1,161 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+/* This program writes a deterministic stream of synthetic graphs in planar
+ * code to standard out. It can be used to test the other programs and to
+ * measure their throughput without having fullgen available.
+ *
+ *
+ * Compile with:
+ *
+ *     cc -o generate_graphs -O4 generate_graphs.c corpus.c output.c -lz
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <getopt.h>
+#include <string.h>
+
+#include "corpus.h"
+#include "output.h"
+
+#define BATCHSIZE 1024 /* the number of graphs that are generated at once */
+
+#define PENTAGONGRAPHS 0
+#define FULLERENES 1
+#define NANOTUBES 2
+
+//====================== USAGE =======================
+
+void help(char *name) {
+    fprintf(stderr, "The program %s generates synthetic graphs in planar code.\n\n", name);
+    fprintf(stderr, "Usage\n=====\n");
+    fprintf(stderr, " %s [options]\n\n", name);
+    fprintf(stderr, "\nThe same seed always gives the same stream of graphs.\n\n");
+    fprintf(stderr, "Valid options\n=============\n");
+    fprintf(stderr, "    -h, --help\n");
+    fprintf(stderr, "       Print this help and return.\n");
+    fprintf(stderr, "    -t, --type type\n");
+    fprintf(stderr, "       The type of graphs that is generated:\n");
+    fprintf(stderr, "         pentagon   pentagonal adjacency graphs with 12 vertices (default)\n");
+    fprintf(stderr, "         fullerene  C20 and C60 with random labellings\n");
+    fprintf(stderr, "         nanotube   nanotubes with five-fold symmetry\n");
+    fprintf(stderr, "    -c, --count n\n");
+    fprintf(stderr, "       Generate n graphs. The default is 1000. Use 0 for an endless stream.\n");
+    fprintf(stderr, "    -s, --seed seed\n");
+    fprintf(stderr, "       Use the given non-zero seed.\n");
+    fprintf(stderr, "    -l, --max-length n\n");
+    fprintf(stderr, "       Nanotubes contain at most n rings of hexagons. The default is 20.\n");
+}
+
+void usage(char *name) {
+    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "For more information type: %s -h \n\n", name);
+}
+
+int main(int argc, char *argv[]) {
+
+    /*=========== commandline parsing ===========*/
+
+    int c;
+    char *name = argv[0];
+    static struct option long_options[] = {
+        {"help", no_argument, NULL, 'h'},
+        {"type", required_argument, NULL, 't'},
+        {"count", required_argument, NULL, 'c'},
+        {"seed", required_argument, NULL, 's'},
+        {"max-length", required_argument, NULL, 'l'},
+        {NULL, 0, NULL, 0}
+    };
+    int option_index = 0;
+
+    int type = PENTAGONGRAPHS;
+    long long count = 1000;
+    unsigned long long seed = 0x5EED;
+    int maxLength = 20;
+
+    while ((c = getopt_long(argc, argv, "ht:c:s:l:", long_options, &option_index)) != -1) {
+        switch (c) {
+            case 'h':
+                help(name);
+                return EXIT_SUCCESS;
+            case 't':
+                if(strcmp(optarg, "pentagon") == 0){
+                    type = PENTAGONGRAPHS;
+                } else if(strcmp(optarg, "fullerene") == 0){
+                    type = FULLERENES;
+                } else if(strcmp(optarg, "nanotube") == 0){
+                    type = NANOTUBES;
+                } else {
+                    fprintf(stderr, "Unknown type %s.\n", optarg);
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'c':
+                count = atoll(optarg);
+                if(count < 0){
+                    fprintf(stderr, "The number of graphs should not be negative.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                if(seed == 0){
+                    fprintf(stderr, "The seed should be non-zero.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'l':
+                maxLength = atoi(optarg);
+                if(maxLength < 0){
+                    fprintf(stderr, "The length of the nanotubes should not be negative.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case '?':
+                usage(name);
+                return EXIT_FAILURE;
+            default:
+                fprintf(stderr, "Illegal option %c.\n", c);
+                usage(name);
+                return EXIT_FAILURE;
+        }
+    }
+
+    /*=========== generate graphs ===========*/
+
+    CORPUS corpus;
+    long long generated = 0;
+    initCorpus(&corpus);
+    while (count == 0 || generated < count) {
+        int batch = BATCHSIZE;
+        if(count && count - generated < batch){
+            batch = count - generated;
+        }
+        if(type == PENTAGONGRAPHS){
+            addPentagonGraphs(&corpus, batch, &seed);
+        } else if(type == FULLERENES){
+            addFullerenes(&corpus, batch, &seed);
+        } else {
+            addNanotubes(&corpus, batch, maxLength, &seed);
+        }
+        writeBytes(corpus.data, corpus.length);
+        clearCorpus(&corpus);
+        generated += batch;
+    }
+    flushOutput();
+    freeCorpus(&corpus);
+
+    fprintf(stderr, "Generated %lld graph%s.\n", generated, generated==1 ? "" : "s");
+
+    return EXIT_SUCCESS;
+}
@@ -11,7 +11,7 @@
  * 
  * Compile with:
  *     
- *     cc -o has_six_cluster -O4 has_six_cluster.c
+ *     cc -o has_six_cluster -O4 has_six_cluster.c output.c stats.c progress.c input.c parallel.c -pthread -lz -llzma
  * 
  */
 
@@ -20,13 +20,19 @@
 #include <getopt.h>
 #include <string.h>
 
+#include "output.h"
+#include "stats.h"
+#include "progress.h"
+#include "input.h"
+#include "parallel.h"
+
 
 #ifndef MAXN
-#define MAXN 12            /* the maximum number of vertices */
+#define MAXN 12            /* the initial maximum number of vertices */
 #endif
-#define MAXE (6*MAXN-12)    /* the maximum number of oriented edges */
-#define MAXVAL (MAXN-1)  /* the maximum degree of a vertex */
-#define MAXCODELENGTH (MAXN+MAXE+3)
+#define EDGECOUNT(n) (6*(n)-12)    /* the maximum number of oriented edges */
+#define MAXVAL (maxn-1)  /* the maximum degree of a vertex */
+#define CODELENGTH(n) ((n)+EDGECOUNT(n)+3)
 
 #define FALSE 0
 #define TRUE  1
@@ -42,22 +48,84 @@ typedef struct e /* The data type used for edges */ {
     struct e *inverse; /* the edge that is inverse to this one */
 } EDGE;
 
-EDGE *firstedge[MAXN]; /* pointer to arbitrary edge out of vertex i. */
-int degree[MAXN];
+/* The storage for the graphs is sized at runtime. The static arrays are used
+ * as long as the graphs have at most MAXN vertices. Once a larger graph is read
+ * (or a larger size is requested with --max-n) the storage moves to the heap,
+ * where it is reused for all later graphs. Each thread has its own storage,
+ * which is attached on the first call to ensureCapacity.
+ */
+__thread int maxn = MAXN; /* the number of vertices for which storage is available */
+
+__thread EDGE *firstedgeStorage[MAXN];
+__thread int degreeStorage[MAXN];
+__thread EDGE edgesStorage[EDGECOUNT(MAXN)];
 
-EDGE edges[MAXE];
+__thread EDGE **firstedge = NULL; /* pointer to arbitrary edge out of vertex i. */
+__thread int *degree = NULL;
+
+__thread EDGE *edges = NULL;
 
 int numberOfGraphs = 0;
 int numberOfSixClusters = 0;
 
-int nv;
-int ne;
+boolean writeOriginals = FALSE; /* the input contains the original graphs */
+
+/* Writes the rank of a graph that matches, or its original graph when the
+ * input contains the original graphs.
+ */
+void writeMatch(int rank, unsigned short *original, int originalLength){
+    if(writeOriginals){
+        writePlanarCode(original, originalLength);
+    } else {
+        writeInt(rank);
+        writeByte(' ');
+    }
+}
+
+/* Writes the number of graphs with a 6-cluster for a progress report. */
+void reportSixClusterCount(FILE *f){
+    int count = __atomic_load_n(&numberOfSixClusters, __ATOMIC_RELAXED);
+    fprintf(f, "Found %d graph%s with a 6-cluster so far.\n", count, count==1 ? "" : "s");
+}
+
+__thread int nv;
+__thread int ne;
 
 //=============== Checking for property ===========================
 
-boolean visited[12];
-boolean currentCluster[12];
-int currentClusterSize;
+__thread boolean visitedStorage[MAXN];
+__thread int stackStorage[MAXN];
+
+__thread boolean *visited = NULL;
+__thread int *stack = NULL;
+__thread int currentClusterSize;
+
+/* A 6-cluster is connected, so a graph needs at least 5 edges to contain one.
+ * Since no edges can leave a 6-cluster, a graph with i vertices that contains
+ * one has at most as many edges as a planar graph on 6 vertices and a planar
+ * graph on i-6 vertices together. Graphs with a degree sum (i.e., twice the
+ * number of edges) outside of these bounds are rejected before any cluster
+ * is built.
+ */
+#define MINSIXDEGREESUM 10
+int maxSixDegreeSumTable[MAXN+1];
+
+int maxPlanarEdges(int n){
+    if(n < 3) return n < 2 ? 0 : 1;
+    return 3*n - 6;
+}
+
+int maxSixDegreeSum(int n){
+    if(n < 6) return -1;
+    return 2*(maxPlanarEdges(6) + maxPlanarEdges(n - 6));
+}
+
+void buildDegreeSumBounds(){
+    int i;
+    for(i = 0; i <= MAXN; i++){
+        maxSixDegreeSumTable[i] = maxSixDegreeSum(i);
+    }
+}
 
 //some macros for the stack in the next method
 #define PUSH(stack, value) stack[top++] = (value)
@@ -65,24 +133,31 @@ int currentClusterSize;
 #define STACKISEMPTY top==0
 #define STACKISNOTEMPTY top>0
 
-boolean hasSixCluster(){
-    int i, j, top, currentVertex;
-    int stack[12];
+/* The body of hasSixCluster for graphs with n vertices. This function is
+ * inlined with a constant n for the pentagonal adjacency graphs of fullerenes,
+ * so that case gets its own specialised copy.
+ */
+static inline boolean hasSixClusterOfOrder(int n){
+    int i, top, currentVertex;
+    int visitedCount = 0;
+    
+    if(ne < MINSIXDEGREESUM ||
+            ne > (n <= MAXN ? maxSixDegreeSumTable[n] : maxSixDegreeSum(n))) return FALSE;
     
-    for(i = 0; i < 12; i++){
+    for(i = 0; i < n; i++){
         visited[i] = FALSE;
     }
     
-    for(i = 0; i < nv; i++){
+    for(i = 0; i < n; i++){
         if(!visited[i]){
-            for(j = 0; j < 12; j++){
-                currentCluster[j] = FALSE;
-            }
+            //not enough vertices left for a 6-cluster
+            if(n - visitedCount < 6) return FALSE;
             
             //build cluster containing vertex i
             top = 0;
             PUSH(stack, i);
-            visited[i] = currentCluster[i] = TRUE;
+            visited[i] = TRUE;
+            visitedCount++;
             currentClusterSize = 1;
             while(STACKISNOTEMPTY){
                 currentVertex = POP(stack);
@@ -93,8 +168,13 @@ boolean hasSixCluster(){
                     do {
                         if (!visited[e->end]) {
                             PUSH(stack, e->end);
-                            visited[e->end] = currentCluster[e->end] = TRUE;
-                            currentClusterSize++;
+                            visited[e->end] = TRUE;
+                            visitedCount++;
+                            if(++currentClusterSize == 7 && n - visitedCount < 6){
+                                //this cluster is too large and the rest of
+                                //the graph is too small for a 6-cluster
+                                return FALSE;
+                            }
                         }
                         e = e->next;
                     } while (e != elast);
@@ -109,6 +189,66 @@ boolean hasSixCluster(){
     return FALSE;
 }
 
+boolean hasSixCluster(){
+    if(nv == 12){
+        return hasSixClusterOfOrder(12);
+    }
+    return hasSixClusterOfOrder(nv);
+}
+
+//=============== Graph storage ===========================
+
+/* Returns storage for count elements of the given size to replace current.
+ * The contents are not preserved. The initial storage is the static array,
+ * which is never freed.
+ */
+void *resizeStorage(void *current, void *initial, size_t count, size_t size){
+    if(current != initial){
+        free(current);
+    }
+    void *storage = malloc(count * size);
+    if(storage == NULL){
+        fprintf(stderr, "Insufficient memory for the graph storage -- exiting!\n");
+        exit(1);
+    }
+    return storage;
+}
+
+/* Makes sure that graphs with n vertices fit in the graph storage. The storage
+ * grows by at least half of its size to avoid repeated resizing when the
+ * graphs grow gradually.
+ */
+void ensureCapacity(int n){
+    if(firstedge == NULL){
+        //each thread starts with its own static storage
+        firstedge = firstedgeStorage;
+        degree = degreeStorage;
+        edges = edgesStorage;
+        visited = visitedStorage;
+        stack = stackStorage;
+    }
+    if(n <= maxn) return;
+    if(n < maxn + maxn/2){
+        n = maxn + maxn/2;
+    }
+    firstedge = resizeStorage(firstedge, firstedgeStorage, n, sizeof(EDGE *));
+    degree = resizeStorage(degree, degreeStorage, n, sizeof(int));
+    edges = resizeStorage(edges, edgesStorage, EDGECOUNT(n), sizeof(EDGE));
+    visited = resizeStorage(visited, visitedStorage, n, sizeof(boolean));
+    stack = resizeStorage(stack, stackStorage, n, sizeof(int));
+    maxn = n;
+}
+
+void growCodeBuffer(unsigned short **code, int *capacity, int newCapacity){
+    unsigned short *buffer = realloc(*code, newCapacity * sizeof(unsigned short));
+    if(buffer == NULL){
+        fprintf(stderr, "Insufficient memory for a code of length %d -- exiting!\n", newCapacity);
+        exit(1);
+    }
+    *code = buffer;
+    *capacity = newCapacity;
+}
+
 //=============== Reading and decoding planarcode ===========================
 
 EDGE *findEdge(int from, int to) {
@@ -135,6 +275,8 @@ void decodePlanarCode(unsigned short* code) {
     nv = code[0];
     codePosition = 1;
 
+    ensureCapacity(nv);
+
     for (i = 0; i < nv; i++) {
         degree[i] = 0;
         if(code[codePosition]){
@@ -179,20 +321,41 @@ void decodePlanarCode(unsigned short* code) {
     ne = edgeCounter;
 }
 
+/* Returns the next byte of a code or header. Exits if the input ends there,
+ * instead of storing EOF in the code and reading on forever.
+ */
+static inline unsigned short readCodeByte(FILE *file){
+    int c = getc(file);
+    if (c == EOF) {
+        fprintf(stderr, "The input ends in the middle of a graph -- exiting!\n");
+        exit(1);
+    }
+    return c;
+}
+
 /**
- * 
- * @param code
+ * Reads the next code into *codePointer. The buffer is (re)allocated when
+ * it is too small for the code and *codeCapacity is updated accordingly.
+ *
+ * @param codePointer
+ * @param codeCapacity
  * @param length
  * @param file
  * @return returns 1 if a code was read and 0 otherwise. Exits in case of error.
  */
-int readPlanarCode(unsigned short code[], int *length, FILE *file) {
+int readPlanarCode(unsigned short **codePointer, int *codeCapacity, int *length, FILE *file) {
     static int first = 1;
     unsigned char c;
     char testheader[20];
     int bufferSize, zeroCounter;
     
     int readCount;
+    unsigned short *code;
+
+    if (*codeCapacity < CODELENGTH(maxn)) {
+        growCodeBuffer(codePointer, codeCapacity, CODELENGTH(maxn));
+    }
+    code = *codePointer;
 
 
     if (first) {
@@ -235,16 +398,16 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
         code[0] = c;
         bufferSize = 1;
         zeroCounter = 0;
-        code[1] = (unsigned short) getc(file);
+        code[1] = readCodeByte(file);
         if (code[1] == 0) zeroCounter++;
-        code[2] = (unsigned short) getc(file);
+        code[2] = readCodeByte(file);
         if (code[2] == 0) zeroCounter++;
         bufferSize = 3;
         // 3 characters were read and stored in buffer
         if ((code[1] == '>') && (code[2] == 'p')) /*we are sure that we're dealing with a header*/ {
-            while ((c = getc(file)) != '<');
+            while ((c = readCodeByte(file)) != '<');
             /* read 2 more characters: */
-            c = getc(file);
+            c = readCodeByte(file);
             if (c != '<') {
                 fprintf(stderr, "Problems with header -- single '<'\n");
                 exit(1);
@@ -264,12 +427,16 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
 
     if (c != 0) /* unsigned chars would be sufficient */ {
         code[0] = c;
-        if (code[0] > MAXN) {
-            fprintf(stderr, "Constant N too small %d > %d \n", code[0], MAXN);
-            exit(1);
+        if (*codeCapacity < CODELENGTH(code[0])) {
+            growCodeBuffer(codePointer, codeCapacity, CODELENGTH(code[0]));
+            code = *codePointer;
         }
         while (zeroCounter < code[0]) {
-            code[bufferSize] = (unsigned short) getc(file);
+            if (bufferSize == *codeCapacity) {
+                growCodeBuffer(codePointer, codeCapacity, 2 * *codeCapacity);
+                code = *codePointer;
+            }
+            code[bufferSize] = readCodeByte(file);
             if (code[bufferSize] == 0) zeroCounter++;
             bufferSize++;
         }
@@ -279,13 +446,17 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
             fprintf(stderr, "Unexpected EOF.\n");
             exit(1);
         }
-        if (code[0] > MAXN) {
-            fprintf(stderr, "Constant N too small %d > %d \n", code[0], MAXN);
-            exit(1);
+        if (*codeCapacity < CODELENGTH(code[0])) {
+            growCodeBuffer(codePointer, codeCapacity, CODELENGTH(code[0]));
+            code = *codePointer;
         }
         bufferSize = 1;
         zeroCounter = 0;
         while (zeroCounter < code[0]) {
+            if (bufferSize == *codeCapacity) {
+                growCodeBuffer(codePointer, codeCapacity, 2 * *codeCapacity);
+                code = *codePointer;
+            }
             readCount = fread(code + bufferSize, sizeof (unsigned short), 1, file);
             if(!readCount){
                 fprintf(stderr, "Unexpected EOF.\n");
@@ -302,21 +473,82 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
 
 }
 
+//=============== Parallel analysis ===========================
+
+/* Writes the match for code i of the batch. Its original is the next code,
+ * which only exists with --original: without it, i + 2 can be past the end of
+ * codeStart.
+ */
+void writeBatchMatch(BATCH *batch, int i, int rank){
+    if(writeOriginals){
+        writeMatch(rank, batch->codes + batch->codeStart[i + 1],
+                batch->codeStart[i + 2] - batch->codeStart[i + 1]);
+    } else {
+        writeMatch(rank, NULL, 0);
+    }
+}
+
+void analyseBatch(BATCH *batch){
+    int i, step = writeOriginals ? 2 : 1, found = 0;
+    for(i = 0; i < batch->count; i += step){
+        startGraph();
+        decodePlanarCode(batch->codes + batch->codeStart[i]);
+        markStage(STAGE_DECODE);
+        if(hasSixCluster()){
+            markStage(STAGE_ANALYSIS);
+            found++;
+            writeBatchMatch(batch, i, batch->firstGraph + i/step + 1);
+            markStage(STAGE_OUTPUT);
+        } else {
+            markStage(STAGE_ANALYSIS);
+        }
+    }
+    //added after each batch, so that progress reports include it
+    __atomic_add_fetch(&numberOfSixClusters, found, __ATOMIC_RELAXED);
+}
+
+PARALLELANALYSIS parallelAnalysis = {NULL, analyseBatch, NULL};
+
 //====================== USAGE =======================
 
 void help(char *name) {
     fprintf(stderr, "The program %s searches for pentagonal adjacency graphs that\ncontain a 6-cluster.\n\n", name);
     fprintf(stderr, "Usage\n=====\n");
-    fprintf(stderr, " %s [options]\n\n", name);
-    fprintf(stderr, "\nThis program can handle graphs up to %d vertices. Recompile if you need larger\n", MAXN);
-    fprintf(stderr, "graphs.\n\n");
+    fprintf(stderr, " %s [options] [file ...]\n\n", name);
+    fprintf(stderr, "\nThe graphs are read from the given files one after the other, or from\n");
+    fprintf(stderr, "standard in if no files are given.\n");
+    fprintf(stderr, "The storage for the graphs grows when larger graphs are read. Use the\n");
+    fprintf(stderr, "option --max-n to allocate it for a given number of vertices in advance.\n\n");
     fprintf(stderr, "Valid options\n=============\n");
     fprintf(stderr, "    -h, --help\n");
     fprintf(stderr, "       Print this help and return.\n");
+    fprintf(stderr, "    -m, --max-n n\n");
+    fprintf(stderr, "       Allocate the storage for graphs with up to n vertices at the start.\n");
+    fprintf(stderr, "    --stats[=file]\n");
+    fprintf(stderr, "       Write statistics about this run (time per stage, throughput and graph\n");
+    fprintf(stderr, "       sizes) in JSON to stderr or to the given file.\n");
+    fprintf(stderr, "    --progress seconds\n");
+    fprintf(stderr, "       Report the progress every given number of seconds. A report is also\n");
+    fprintf(stderr, "       written to stderr when the program receives SIGUSR1.\n");
+    fprintf(stderr, "    --async-input\n");
+    fprintf(stderr, "       Read the input on a separate thread, so reading and processing overlap.\n");
+    fprintf(stderr, "    -t, --threads n\n");
+    fprintf(stderr, "       Analyse the graphs on n threads. The default is 1.\n");
+    fprintf(stderr, "    -u, --unordered prefix\n");
+    fprintf(stderr, "       Do not keep the order of the input: each thread writes its output to\n");
+    fprintf(stderr, "       the file prefix.i as soon as a batch of graphs is analysed, and\n");
+    fprintf(stderr, "       prefix.manifest lists these files. The output of a batch is written\n");
+    fprintf(stderr, "       as a record with the rank of its first graph, its number of graphs and\n");
+    fprintf(stderr, "       its length, followed by the ranks (or with --original the graphs)\n");
+    fprintf(stderr, "       that match.\n");
+    fprintf(stderr, "    -o, --original\n");
+    fprintf(stderr, "       The input contains each pentagon partition followed by the original\n");
+    fprintf(stderr, "       graph, as written by pentagon_partition --original. Write the\n");
+    fprintf(stderr, "       original graphs that match in planar code instead of their ranks.\n");
 }
 
 void usage(char *name) {
-    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "Usage: %s [options] [file ...]\n", name);
     fprintf(stderr, "For more information type: %s -h \n\n", name);
 }
 
@@ -327,15 +559,58 @@ int main(int argc, char *argv[]) {
     int c;
     char *name = argv[0];
     static struct option long_options[] = {
-        {"help", no_argument, NULL, 'h'}
+        {"help", no_argument, NULL, 'h'},
+        {"max-n", required_argument, NULL, 'm'},
+        {"stats", optional_argument, NULL, 'S'},
+        {"progress", required_argument, NULL, 'T'},
+        {"async-input", no_argument, NULL, 'A'},
+        {"threads", required_argument, NULL, 't'},
+        {"unordered", required_argument, NULL, 'u'},
+        {"original", no_argument, NULL, 'o'},
+        {NULL, 0, NULL, 0}
     };
     int option_index = 0;
+    int progressInterval = 0;
+    int threadCount = 1;
+    boolean asyncInput = FALSE;
 
-    while ((c = getopt_long(argc, argv, "h", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "hm:t:ou:", long_options, &option_index)) != -1) {
         switch (c) {
             case 'h':
                 help(name);
                 return EXIT_SUCCESS;
+            case 'm':
+                ensureCapacity(atoi(optarg));
+                break;
+            case 'S':
+                initStats(optarg);
+                break;
+            case 't':
+                threadCount = atoi(optarg);
+                if(threadCount < 1){
+                    fprintf(stderr, "The number of threads should be positive.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                asyncInput = TRUE;
+                break;
+            case 'u':
+                startUnorderedOutput(optarg);
+                break;
+            case 'o':
+                writeOriginals = TRUE;
+                parallelAnalysis.codesPerGraph = 2;
+                break;
+            case 'T':
+                progressInterval = atoi(optarg);
+                if(progressInterval < 1){
+                    fprintf(stderr, "The progress interval should be positive.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
             case '?':
                 usage(name);
                 return EXIT_FAILURE;
@@ -346,26 +621,57 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    buildDegreeSumBounds();
+
     /*=========== read pentagonal partition graphs ===========*/
 
-    unsigned short code[MAXCODELENGTH];
-    int length;
-    while (readPlanarCode(code, &length, stdin)) {
-        decodePlanarCode(code);
-        numberOfGraphs++;
+    startProgress(&numberOfGraphs, progressInterval, reportSixClusterCount);
+    FILE *input = optind < argc ?
+            openInputFiles(argv + optind, argc - optind, asyncInput) : openInput(0, asyncInput);
+
+    if(writeOriginals && unorderedPrefix == NULL){
+        writeString(">>planar_code<<");
+    }
+    if(threadCount > 1 || unorderedPrefix != NULL){
+        analyseInParallel(input, threadCount, &parallelAnalysis, &numberOfGraphs);
+    } else {
+        unsigned short *code = NULL, *original = NULL;
+        int codeCapacity = 0, originalCapacity = 0;
+        int length, originalLength = 0;
+        startGraph();
+        while (readPlanarCode(&code, &codeCapacity, &length, input)) {
+            if(writeOriginals && !readPlanarCode(&original, &originalCapacity, &originalLength, input)){
+                fprintf(stderr, "The input ends in the middle of a graph -- exiting!\n");
+                exit(1);
+            }
+            markStage(STAGE_READ);
+            decodePlanarCode(code);
+            recordGraph(nv, ne, length);
+            markStage(STAGE_DECODE);
+            numberOfGraphs++;
         
-        if(hasSixCluster()){
-            numberOfSixClusters++;
-            fprintf(stdout, "%d ", numberOfGraphs);
+            if(hasSixCluster()){
+                markStage(STAGE_ANALYSIS);
+                numberOfSixClusters++;
+                writeMatch(numberOfGraphs, original, originalLength);
+                markStage(STAGE_OUTPUT);
+            } else {
+                markStage(STAGE_ANALYSIS);
+            }
+            startGraph();
         }
     }
-    if(numberOfSixClusters){
-        fprintf(stdout, "\n");
+    startSection();
+    if(numberOfSixClusters && !writeOriginals && unorderedPrefix == NULL){
+        writeByte('\n');
     }
+    flushOutput();
+    markStage(STAGE_OUTPUT);
     
     fprintf(stderr, "Read %d graph%s.\n", numberOfGraphs, numberOfGraphs==1 ? "" : "s");
     fprintf(stderr, "Found %d graph%s with a 6-cluster.\n", numberOfSixClusters, 
                 numberOfSixClusters==1 ? "" : "s");
+    finishStats();
     
     return EXIT_SUCCESS;
 }
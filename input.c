@@ -0,0 +1,780 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <zlib.h>
+#include <lzma.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#include <zstd_errors.h>
+#endif
+
+#include "input.h"
+
+#define PLAIN 0
+#define GZIP 1
+#define XZ 2
+#define ZSTD 3
+
+#define MAGICLENGTH 6 /* the length of the longest magic number */
+
+#ifdef HAVE_ZSTD
+#define ZSTDMAXFRAME (64<<20) /* larger zstd frames are decompressed on one thread */
+
+typedef struct {
+    unsigned char *compressed;
+    size_t compressedLength;
+    size_t compressedCapacity;
+    unsigned char *data;
+    size_t length;
+    size_t capacity;
+    ZSTD_DCtx *context;
+    pthread_t thread;
+} ZSTDFRAME;
+#endif
+
+typedef struct {
+    int fd;
+    unsigned long long *bytesRead; /* counts the bytes that were read from fd */
+    int format;
+    unsigned char magic[MAGICLENGTH]; /* the first bytes, which are read first */
+    size_t magicLength;
+    size_t magicPosition;
+
+    unsigned char *compressed; /* input for the decompressor */
+    int inputEnded; /* whether the end of fd was reached */
+    int ended; /* whether all data was decompressed */
+    z_stream gzip;
+    lzma_stream xz;
+#ifdef HAVE_ZSTD
+    ZSTDFRAME *zstdFrames;
+    int zstdFrameCount; /* the number of frames that are decompressed at once */
+    int zstdFramesRead; /* the number of frames in the current group */
+    int zstdFrame; /* the frame of the group that is being read */
+    size_t zstdPosition; /* the position in the data of that frame */
+    unsigned char *zstdPending; /* data that was read, but does not form a frame yet */
+    size_t zstdPendingLength;
+    size_t zstdPendingCapacity;
+
+    /* After a frame of more than ZSTDMAXFRAME bytes the rest is streamed. */
+    int zstdStreaming;
+    ZSTD_DStream *zstd;
+    ZSTD_inBuffer zstdInput;
+    size_t zstdRemaining; /* 0 at the end of a frame */
+#endif
+} SOURCE;
+
+typedef struct {
+    SOURCE *source;
+    unsigned char *data[INPUTBUFFERCOUNT];
+    size_t length[INPUTBUFFERCOUNT]; /* a buffer of length 0 marks the end */
+
+    /* The number of buffers that were filled and released. Buffer i is used
+     * for the fills i, i + INPUTBUFFERCOUNT, ...
+     */
+    unsigned int filled;
+    unsigned int released;
+    int consumerWaiting;
+
+    size_t position; /* the position in the current buffer */
+    int finished; /* whether the consumer reached the end */
+    pthread_t thread;
+} ASYNCINPUT;
+
+/* For the progress reports: the total size of the input files (0 if it is
+ * not known) and the number of bytes that were read from them.
+ */
+static unsigned long long inputSize = 0;
+static unsigned long long inputBytesRead = 0;
+static int directInput = 0; /* whether standard in is read without the input layer */
+
+static void waitWhileEqual(unsigned int *address, unsigned int value){
+    syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void wakeWaiters(unsigned int *address){
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+//=============== Reading and decompressing ===========================
+
+static void inputError(const char *message){
+    fprintf(stderr, "%s -- exiting!\n", message);
+    exit(1);
+}
+
+/* Reads up to size bytes of fd, starting with the bytes that were read to
+ * detect the format. Returns 0 at the end of the input.
+ */
+static size_t readRaw(SOURCE *source, unsigned char *buffer, size_t size){
+    if(source->magicPosition < source->magicLength){
+        size_t count = source->magicLength - source->magicPosition;
+        if(count > size) count = size;
+        memcpy(buffer, source->magic + source->magicPosition, count);
+        source->magicPosition += count;
+        __atomic_add_fetch(source->bytesRead, count, __ATOMIC_RELAXED);
+        return count;
+    }
+    while(1){
+        ssize_t count = read(source->fd, buffer, size);
+        if(count >= 0){
+            __atomic_add_fetch(source->bytesRead, count, __ATOMIC_RELAXED);
+            return count;
+        }
+        if(errno != EINTR) inputError("Error while reading input");
+    }
+}
+
+/* Fills the input of the decompressor if it is empty. Returns the number of
+ * new bytes, which is 0 at the end of the input.
+ */
+static size_t readCompressed(SOURCE *source){
+    size_t count = source->inputEnded ? 0 : readRaw(source, source->compressed, INPUTBUFFERSIZE);
+    if(count == 0) source->inputEnded = 1;
+    return count;
+}
+
+/* Decompresses gzip data. A new member may follow the end of a member. */
+static size_t readGzip(SOURCE *source, unsigned char *buffer, size_t size){
+    z_stream *stream = &source->gzip;
+    stream->next_out = buffer;
+    stream->avail_out = size;
+    while(stream->avail_out == size && !source->ended){
+        if(stream->avail_in == 0){
+            size_t count = readCompressed(source);
+            if(count == 0) inputError("The compressed input is truncated");
+            stream->next_in = source->compressed;
+            stream->avail_in = count;
+        }
+        int result = inflate(stream, Z_NO_FLUSH);
+        if(result == Z_STREAM_END){
+            if(stream->avail_in == 0){
+                size_t count = readCompressed(source);
+                stream->next_in = source->compressed;
+                stream->avail_in = count;
+            }
+            if(stream->avail_in == 0){
+                source->ended = 1;
+            } else if(inflateReset(stream) != Z_OK){
+                inputError("Error while decompressing the input");
+            }
+        } else if(result != Z_OK && result != Z_BUF_ERROR){
+            inputError("Error while decompressing the input");
+        }
+    }
+    return size - stream->avail_out;
+}
+
+static size_t readXz(SOURCE *source, unsigned char *buffer, size_t size){
+    lzma_stream *stream = &source->xz;
+    stream->next_out = buffer;
+    stream->avail_out = size;
+    while(stream->avail_out == size && !source->ended){
+        if(stream->avail_in == 0 && !source->inputEnded){
+            stream->next_in = source->compressed;
+            stream->avail_in = readCompressed(source);
+        }
+        lzma_ret result = lzma_code(stream, source->inputEnded ? LZMA_FINISH : LZMA_RUN);
+        if(result == LZMA_STREAM_END){
+            source->ended = 1;
+        } else if(result == LZMA_BUF_ERROR && source->inputEnded){
+            inputError("The compressed input is truncated");
+        } else if(result != LZMA_OK){
+            inputError("Error while decompressing the input");
+        }
+    }
+    return size - stream->avail_out;
+}
+
+#ifdef HAVE_ZSTD
+/* Makes the buffer at least size bytes large. */
+static void growBuffer(unsigned char **buffer, size_t *capacity, size_t size){
+    size_t newCapacity = *capacity ? *capacity : INPUTBUFFERSIZE;
+    if(*capacity >= size) return;
+    while(newCapacity < size) newCapacity *= 2;
+    *buffer = realloc(*buffer, newCapacity);
+    if(*buffer == NULL){
+        inputError("Insufficient memory for the input");
+    }
+    *capacity = newCapacity;
+}
+
+/* Decompresses a complete frame. This runs on a thread of its own. */
+static void *decompressZstdFrame(void *arg){
+    ZSTDFRAME *frame = arg;
+    ZSTD_inBuffer input = {frame->compressed, frame->compressedLength, 0};
+    unsigned long long size = ZSTD_getFrameContentSize(frame->compressed, frame->compressedLength);
+
+    if(size != ZSTD_CONTENTSIZE_UNKNOWN && size != ZSTD_CONTENTSIZE_ERROR && size < SIZE_MAX){
+        growBuffer(&frame->data, &frame->capacity, size);
+    }
+    ZSTD_DCtx_reset(frame->context, ZSTD_reset_session_only);
+    frame->length = 0;
+    while(1){
+        if(frame->length == frame->capacity){
+            growBuffer(&frame->data, &frame->capacity, frame->capacity + 1);
+        }
+        ZSTD_outBuffer output = {frame->data, frame->capacity, frame->length};
+        size_t result = ZSTD_decompressStream(frame->context, &output, &input);
+        if(ZSTD_isError(result)){
+            inputError("Error while decompressing the input");
+        }
+        frame->length = output.pos;
+        if(result == 0) break;
+        if(input.pos == input.size && output.pos < output.size){
+            inputError("The compressed input is truncated");
+        }
+    }
+    return NULL;
+}
+
+/* Moves the next frame from the input to frame. Returns 0 at the end of the
+ * input, and -1 if the frame is larger than ZSTDMAXFRAME.
+ */
+static int readZstdFrame(SOURCE *source, ZSTDFRAME *frame){
+    while(1){
+        size_t size = ZSTD_findFrameCompressedSize(source->zstdPending, source->zstdPendingLength);
+        if(!ZSTD_isError(size)){
+            growBuffer(&frame->compressed, &frame->compressedCapacity, size);
+            memcpy(frame->compressed, source->zstdPending, size);
+            frame->compressedLength = size;
+            source->zstdPendingLength -= size;
+            memmove(source->zstdPending, source->zstdPending + size, source->zstdPendingLength);
+            return 1;
+        }
+        if(ZSTD_getErrorCode(size) != ZSTD_error_srcSize_wrong){
+            inputError("Error while decompressing the input");
+        }
+        if(source->zstdPendingLength >= ZSTDMAXFRAME){
+            return -1;
+        }
+        if(source->inputEnded){
+            if(source->zstdPendingLength) inputError("The compressed input is truncated");
+            return 0;
+        }
+        growBuffer(&source->zstdPending, &source->zstdPendingCapacity,
+                source->zstdPendingLength + INPUTBUFFERSIZE);
+        size_t count = readRaw(source, source->zstdPending + source->zstdPendingLength, INPUTBUFFERSIZE);
+        if(count == 0) source->inputEnded = 1;
+        source->zstdPendingLength += count;
+    }
+}
+
+/* Continues with the streaming decoder, starting with the data that was read
+ * but does not form a frame yet.
+ */
+static void startZstdStream(SOURCE *source){
+    source->zstdStreaming = 1;
+    source->zstd = ZSTD_createDStream();
+    if(source->zstd == NULL || ZSTD_isError(ZSTD_initDStream(source->zstd))){
+        inputError("Could not start the decompression of the input");
+    }
+    source->zstdInput.src = source->zstdPending;
+    source->zstdInput.size = source->zstdPendingLength;
+    source->zstdInput.pos = 0;
+}
+
+/* Reads the next group of frames and decompresses them, each on a thread of
+ * its own.
+ */
+static void decompressZstdFrames(SOURCE *source){
+    ZSTDFRAME *frames = source->zstdFrames;
+    int i, count = 0, result = 1;
+
+    while(count < source->zstdFrameCount && (result = readZstdFrame(source, frames + count)) > 0){
+        count++;
+    }
+    if(result < 0){
+        startZstdStream(source);
+    } else if(count == 0){
+        source->ended = 1;
+    }
+
+    //the first frame is decompressed on this thread
+    for(i = 1; i < count; i++){
+        if(pthread_create(&frames[i].thread, NULL, decompressZstdFrame, frames + i)){
+            inputError("Could not start a decompression thread");
+        }
+    }
+    if(count){
+        decompressZstdFrame(frames);
+    }
+    for(i = 1; i < count; i++){
+        pthread_join(frames[i].thread, NULL);
+    }
+    source->zstdFramesRead = count;
+    source->zstdFrame = 0;
+    source->zstdPosition = 0;
+}
+
+/* Decompresses the rest of the input with a single streaming decoder. */
+static size_t readZstdStream(SOURCE *source, unsigned char *buffer, size_t size){
+    ZSTD_outBuffer output = {buffer, size, 0};
+    while(output.pos == 0 && !source->ended){
+        if(source->zstdInput.pos == source->zstdInput.size){
+            size_t count = readCompressed(source);
+            if(count == 0){
+                if(source->zstdRemaining) inputError("The compressed input is truncated");
+                source->ended = 1;
+                break;
+            }
+            source->zstdInput.src = source->compressed;
+            source->zstdInput.size = count;
+            source->zstdInput.pos = 0;
+        }
+        source->zstdRemaining = ZSTD_decompressStream(source->zstd, &output, &source->zstdInput);
+        if(ZSTD_isError(source->zstdRemaining)){
+            inputError("Error while decompressing the input");
+        }
+    }
+    return output.pos;
+}
+
+/* Decompresses zstd data. The frames are decompressed in groups of
+ * zstdFrameCount frames in parallel, and then handed out in order.
+ */
+static size_t readZstd(SOURCE *source, unsigned char *buffer, size_t size){
+    while(!source->ended){
+        if(source->zstdFrame < source->zstdFramesRead){
+            ZSTDFRAME *frame = source->zstdFrames + source->zstdFrame;
+            size_t count = frame->length - source->zstdPosition;
+            if(count > size) count = size;
+            memcpy(buffer, frame->data + source->zstdPosition, count);
+            source->zstdPosition += count;
+            if(source->zstdPosition == frame->length){
+                source->zstdFrame++;
+                source->zstdPosition = 0;
+            }
+            //skippable frames are empty
+            if(count) return count;
+        } else if(source->zstdStreaming){
+            return readZstdStream(source, buffer, size);
+        } else {
+            decompressZstdFrames(source);
+        }
+    }
+    return 0;
+}
+#endif
+
+/* Reads up to size bytes of decompressed data. Returns 0 at the end. */
+static size_t readSource(SOURCE *source, unsigned char *buffer, size_t size){
+    switch(source->format){
+        case GZIP:
+            return readGzip(source, buffer, size);
+        case XZ:
+            return readXz(source, buffer, size);
+#ifdef HAVE_ZSTD
+        case ZSTD:
+            return readZstd(source, buffer, size);
+#endif
+        default:
+            return readRaw(source, buffer, size);
+    }
+}
+
+static void closeSource(SOURCE *source){
+    if(source->format == GZIP){
+        inflateEnd(&source->gzip);
+    } else if(source->format == XZ){
+        lzma_end(&source->xz);
+    }
+#ifdef HAVE_ZSTD
+    if(source->format == ZSTD){
+        int i;
+        for(i = 0; i < source->zstdFrameCount; i++){
+            ZSTD_freeDCtx(source->zstdFrames[i].context);
+            free(source->zstdFrames[i].compressed);
+            free(source->zstdFrames[i].data);
+        }
+        free(source->zstdFrames);
+        free(source->zstdPending);
+        ZSTD_freeDStream(source->zstd);
+    }
+#endif
+    free(source->compressed);
+    free(source);
+}
+
+/* Reads the first bytes of fd and prepares the decompressor. */
+static SOURCE *openSource(int fd){
+    static const unsigned char gzipMagic[] = {0x1F, 0x8B};
+    static const unsigned char xzMagic[] = {0xFD, '7', 'z', 'X', 'Z', 0x00};
+    static const unsigned char zstdMagic[] = {0x28, 0xB5, 0x2F, 0xFD};
+    SOURCE *source = calloc(1, sizeof(SOURCE));
+    if(source == NULL){
+        inputError("Insufficient memory for the input");
+    }
+    source->fd = fd;
+    source->bytesRead = &inputBytesRead;
+    while(source->magicLength < MAGICLENGTH){
+        ssize_t count = read(fd, source->magic + source->magicLength, MAGICLENGTH - source->magicLength);
+        if(count < 0 && errno == EINTR) continue;
+        if(count < 0) inputError("Error while reading input");
+        if(count == 0) break;
+        source->magicLength += count;
+    }
+
+    if(source->magicLength >= sizeof(gzipMagic) && !memcmp(source->magic, gzipMagic, sizeof(gzipMagic))){
+        source->format = GZIP;
+        //15 + 32: the largest window and a gzip header
+        if(inflateInit2(&source->gzip, 15 + 32) != Z_OK){
+            inputError("Could not start the decompression of the input");
+        }
+    } else if(source->magicLength >= sizeof(xzMagic) && !memcmp(source->magic, xzMagic, sizeof(xzMagic))){
+        source->format = XZ;
+        lzma_stream initial = LZMA_STREAM_INIT;
+        source->xz = initial;
+        lzma_ret result;
+#if LZMA_VERSION >= 50040002
+        lzma_mt options;
+        memset(&options, 0, sizeof(lzma_mt));
+        options.flags = LZMA_CONCATENATED;
+        options.threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if(options.threads < 1) options.threads = 1;
+        options.memlimit_threading = lzma_physmem() / 4;
+        options.memlimit_stop = UINT64_MAX;
+        result = lzma_stream_decoder_mt(&source->xz, &options);
+#else
+        result = lzma_stream_decoder(&source->xz, UINT64_MAX, LZMA_CONCATENATED);
+#endif
+        if(result != LZMA_OK){
+            inputError("Could not start the decompression of the input");
+        }
+    } else if(source->magicLength >= sizeof(zstdMagic) && !memcmp(source->magic, zstdMagic, sizeof(zstdMagic))){
+#ifdef HAVE_ZSTD
+        source->format = ZSTD;
+        source->zstdFrameCount = sysconf(_SC_NPROCESSORS_ONLN);
+        if(source->zstdFrameCount < 1) source->zstdFrameCount = 1;
+        source->zstdFrames = calloc(source->zstdFrameCount, sizeof(ZSTDFRAME));
+        if(source->zstdFrames == NULL){
+            inputError("Insufficient memory for the input");
+        }
+        int i;
+        for(i = 0; i < source->zstdFrameCount; i++){
+            source->zstdFrames[i].context = ZSTD_createDCtx();
+            if(source->zstdFrames[i].context == NULL){
+                inputError("Could not start the decompression of the input");
+            }
+        }
+#else
+        inputError("This program was compiled without support for zstd (make ZSTD=1)");
+#endif
+    } else {
+        source->format = PLAIN;
+    }
+
+    if(source->format != PLAIN){
+        source->compressed = malloc(INPUTBUFFERSIZE);
+        if(source->compressed == NULL){
+            inputError("Insufficient memory for the input");
+        }
+    }
+    return source;
+}
+
+//=============== Asynchronous input ===========================
+
+static void *producer(void *arg){
+    ASYNCINPUT *input = arg;
+    unsigned int fill;
+
+    //the end of the input is marked by an extra, empty buffer
+    for(fill = 0; ; fill++){
+        unsigned int released;
+        while(fill - (released = __atomic_load_n(&input->released, __ATOMIC_ACQUIRE))
+                == INPUTBUFFERCOUNT){
+            waitWhileEqual(&input->released, released);
+        }
+
+        //fill the buffer, but hand it over early when the consumer is waiting
+        int slot = fill % INPUTBUFFERCOUNT;
+        size_t length = 0;
+        while(length < INPUTBUFFERSIZE){
+            size_t count = readSource(input->source, input->data[slot] + length, INPUTBUFFERSIZE - length);
+            if(count == 0) break;
+            length += count;
+            if(__atomic_load_n(&input->consumerWaiting, __ATOMIC_ACQUIRE)) break;
+        }
+        input->length[slot] = length;
+
+        __atomic_store_n(&input->filled, fill + 1, __ATOMIC_RELEASE);
+        wakeWaiters(&input->filled);
+
+        if(length == 0){
+            return NULL;
+        }
+    }
+}
+
+static ssize_t readAsyncInput(void *cookie, char *buffer, size_t size){
+    ASYNCINPUT *input = cookie;
+    size_t copied = 0;
+
+    while(copied < size && !input->finished){
+        unsigned int current = input->released;
+        unsigned int filled = __atomic_load_n(&input->filled, __ATOMIC_ACQUIRE);
+        if(filled == current){
+            if(copied) break;
+            __atomic_store_n(&input->consumerWaiting, 1, __ATOMIC_RELEASE);
+            while((filled = __atomic_load_n(&input->filled, __ATOMIC_ACQUIRE)) == current){
+                waitWhileEqual(&input->filled, current);
+            }
+            __atomic_store_n(&input->consumerWaiting, 0, __ATOMIC_RELEASE);
+        }
+
+        int slot = current % INPUTBUFFERCOUNT;
+        if(input->length[slot] == 0){
+            input->finished = 1;
+            break;
+        }
+        size_t available = input->length[slot] - input->position;
+        size_t count = available < size - copied ? available : size - copied;
+        memcpy(buffer + copied, input->data[slot] + input->position, count);
+        copied += count;
+        input->position += count;
+        if(input->position == input->length[slot]){
+            input->position = 0;
+            __atomic_store_n(&input->released, current + 1, __ATOMIC_RELEASE);
+            wakeWaiters(&input->released);
+        }
+    }
+    return copied;
+}
+
+/* The memory is only freed when the producer has stopped, i.e., when the end
+ * of the input was reached.
+ */
+static int closeAsyncInput(void *cookie){
+    ASYNCINPUT *input = cookie;
+    int i;
+
+    if(!input->finished){
+        return 0;
+    }
+    pthread_join(input->thread, NULL);
+    for(i = 0; i < INPUTBUFFERCOUNT; i++){
+        free(input->data[i]);
+    }
+    closeSource(input->source);
+    free(input);
+    return 0;
+}
+
+static FILE *openAsyncInput(SOURCE *source){
+    int i;
+    ASYNCINPUT *input = calloc(1, sizeof(ASYNCINPUT));
+    if(input == NULL){
+        fprintf(stderr, "Insufficient memory for the input buffers -- exiting!\n");
+        exit(1);
+    }
+    input->source = source;
+    for(i = 0; i < INPUTBUFFERCOUNT; i++){
+        input->data[i] = malloc(INPUTBUFFERSIZE);
+        if(input->data[i] == NULL){
+            fprintf(stderr, "Insufficient memory for the input buffers -- exiting!\n");
+            exit(1);
+        }
+    }
+
+    cookie_io_functions_t functions = {readAsyncInput, NULL, NULL, closeAsyncInput};
+    FILE *stream = fopencookie(input, "r", functions);
+    if(stream == NULL){
+        fprintf(stderr, "Could not open the input stream -- exiting!\n");
+        exit(1);
+    }
+    //the buffers are already large, so stdio only needs a small buffer
+    setvbuf(stream, NULL, _IOFBF, 1<<16);
+
+    if(pthread_create(&input->thread, NULL, producer, input)){
+        fprintf(stderr, "Could not start the input thread -- exiting!\n");
+        exit(1);
+    }
+    return stream;
+}
+
+//=============== Synchronous input ===========================
+
+static ssize_t readSyncInput(void *cookie, char *buffer, size_t size){
+    return readSource(cookie, (unsigned char *)buffer, size);
+}
+
+static int closeSyncInput(void *cookie){
+    closeSource(cookie);
+    return 0;
+}
+
+FILE *openInput(int fd, int async){
+    struct stat status;
+    if(!fstat(fd, &status) && S_ISREG(status.st_mode)){
+        inputSize = status.st_size;
+    }
+    SOURCE *source = openSource(fd);
+
+    if(async){
+        return openAsyncInput(source);
+    }
+
+    //plain data is read directly from fd if the bytes that were read can be put back
+    if(source->format == PLAIN && fd == 0 &&
+            (source->magicLength == 0 || lseek(fd, -(off_t)source->magicLength, SEEK_CUR) != (off_t)-1)){
+        closeSource(source);
+        directInput = 1;
+        return stdin;
+    }
+
+    cookie_io_functions_t functions = {readSyncInput, NULL, NULL, closeSyncInput};
+    FILE *stream = fopencookie(source, "r", functions);
+    if(stream == NULL){
+        inputError("Could not open the input stream");
+    }
+    setvbuf(stream, NULL, _IOFBF, INPUTBUFFERSIZE);
+    return stream;
+}
+
+//=============== Several input files ===========================
+
+typedef struct {
+    char **names;
+    int *fds; /* the descriptors of the files that were started */
+    FILE **streams; /* the streams of the files that were started */
+    unsigned long long *sizes;
+    unsigned long long *bytesRead; /* the bytes read from each file, for the progress reports */
+    int count;
+    int current;
+    int started; /* the number of files that were started */
+} INPUTFILES;
+
+static INPUTFILES *inputFiles = NULL;
+
+/* Opens and starts reading the next files, until INPUTFILESAHEAD files are
+ * being read.
+ */
+static void startInputFiles(INPUTFILES *files){
+    while(files->started < files->count && files->started - files->current < INPUTFILESAHEAD){
+        int fd = open(files->names[files->started], O_RDONLY);
+        if(fd < 0){
+            fprintf(stderr, "Could not open the input file %s -- exiting!\n", files->names[files->started]);
+            exit(1);
+        }
+        files->fds[files->started] = fd;
+        SOURCE *source = openSource(fd);
+        source->bytesRead = files->bytesRead + files->started;
+        files->streams[files->started] = openAsyncInput(source);
+        files->started++;
+    }
+}
+
+static ssize_t readInputFiles(void *cookie, char *buffer, size_t size){
+    INPUTFILES *files = cookie;
+    while(files->current < files->count){
+        size_t count = fread(buffer, 1, size, files->streams[files->current]);
+        if(count) return count;
+        fclose(files->streams[files->current]);
+        close(files->fds[files->current]);
+        __atomic_store_n(&files->current, files->current + 1, __ATOMIC_RELEASE);
+        startInputFiles(files);
+    }
+    return 0;
+}
+
+static int closeInputFiles(void *cookie){
+    INPUTFILES *files = cookie;
+    if(files->current < files->count){
+        return 0;
+    }
+    inputFiles = NULL;
+    free(files->sizes);
+    free(files->bytesRead);
+    free(files->fds);
+    free(files->streams);
+    free(files);
+    return 0;
+}
+
+int inputPosition(unsigned long long *position, unsigned long long *size){
+    if(inputSize == 0){
+        return 0;
+    }
+    if(inputFiles != NULL){
+        //only the current file counts as read ahead, the files after it do not
+        int i, current = __atomic_load_n(&inputFiles->current, __ATOMIC_ACQUIRE);
+        *position = 0;
+        for(i = 0; i < current; i++){
+            *position += inputFiles->sizes[i];
+        }
+        if(current < inputFiles->count){
+            *position += __atomic_load_n(inputFiles->bytesRead + current, __ATOMIC_RELAXED);
+        }
+    } else if(directInput){
+        off_t offset = lseek(0, 0, SEEK_CUR);
+        *position = offset > 0 ? offset : 0;
+    } else {
+        *position = __atomic_load_n(&inputBytesRead, __ATOMIC_RELAXED);
+    }
+    *size = inputSize;
+    return 1;
+}
+
+FILE *openInputFiles(char **names, int count, int async){
+    int i;
+
+    if(count == 1){
+        int fd = open(names[0], O_RDONLY);
+        if(fd < 0){
+            fprintf(stderr, "Could not open the input file %s -- exiting!\n", names[0]);
+            exit(1);
+        }
+        return openInput(fd, async);
+    }
+
+    INPUTFILES *files = calloc(1, sizeof(INPUTFILES));
+    if(files == NULL || (files->fds = malloc(count * sizeof(int))) == NULL ||
+            (files->streams = calloc(count, sizeof(FILE *))) == NULL ||
+            (files->sizes = malloc(count * sizeof(unsigned long long))) == NULL ||
+            (files->bytesRead = calloc(count, sizeof(unsigned long long))) == NULL){
+        inputError("Insufficient memory for the input");
+    }
+    //check all files first, so a missing file is reported at the start
+    unsigned long long size = 0;
+    for(i = 0; i < count; i++){
+        struct stat status;
+        if(access(names[i], R_OK) || stat(names[i], &status)){
+            fprintf(stderr, "Could not open the input file %s -- exiting!\n", names[i]);
+            exit(1);
+        }
+        files->sizes[i] = status.st_size;
+        if(size != ULLONG_MAX){
+            size = S_ISREG(status.st_mode) ? size + status.st_size : ULLONG_MAX;
+        }
+    }
+    inputSize = size != ULLONG_MAX ? size : 0;
+    files->names = names;
+    files->count = count;
+    inputFiles = files;
+    startInputFiles(files);
+
+    cookie_io_functions_t functions = {readInputFiles, NULL, NULL, closeInputFiles};
+    FILE *stream = fopencookie(files, "r", functions);
+    if(stream == NULL){
+        inputError("Could not open the input stream");
+    }
+    setvbuf(stream, NULL, _IOFBF, 1<<16);
+    return stream;
+}
@@ -0,0 +1,62 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+/* The input layer of the programs. The format of the input is detected from
+ * its first bytes: data compressed with gzip or xz (and zstd when compiled
+ * with HAVE_ZSTD) is decompressed while it is read, so readPlanarCode does
+ * not need to change. Streams of several gzip members, xz streams or zstd
+ * frames are read as one. xz input that consists of several blocks (e.g.,
+ * written by xz -T0) is decompressed on several threads. zstd input that
+ * consists of several frames (e.g., written by pzstd) is decompressed in
+ * groups of frames, one frame per thread; from the first frame of more than
+ * ZSTDMAXFRAME bytes on, the input is decompressed on one thread.
+ *
+ * Asynchronous input: a separate thread reads (and decompresses) the input
+ * into a ring of large buffers, while the program decodes the data of the
+ * previous buffers. The buffers are handed over through two counters (single
+ * producer, single consumer), and a thread only sleeps on a futex when the
+ * ring is full or empty.
+ *
+ * Several input files are read as if they were concatenated, so the ranks of
+ * the graphs are the same as for a single run on all files. Each file is only
+ * opened when it is started, and at most INPUTFILESAHEAD files are read and
+ * decompressed at once on separate threads while the program decodes the
+ * current file. A file that is read ahead only fills its ring of buffers, so
+ * this overlaps the start of the next file with the end of the current one,
+ * but otherwise the files are read one after another. The depth is fixed
+ * rather than, e.g., the number of cores, because the files are consumed in
+ * order: more files ahead would only keep more files open and more buffers
+ * filled, without reading the current file any faster.
+ */
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdio.h>
+
+#define INPUTBUFFERCOUNT 4
+#define INPUTBUFFERSIZE (1<<20)
+#define INPUTFILESAHEAD 2 /* the number of input files that are read at once */
+
+/* Returns a stream with the (decompressed) data of fd. If async is true, the
+ * data is read on a separate thread. Exits on error.
+ */
+FILE *openInput(int fd, int async);
+
+/* Returns a stream with the (decompressed) data of the given files, one after
+ * the other. A single file is read like openInput does. Exits on error.
+ */
+FILE *openInputFiles(char **names, int count, int async);
+
+/* Sets *position to the number of bytes of the input (before decompression)
+ * that were read so far and *size to the size of the input. Returns 0 if the
+ * size is not known, e.g., when the input is a pipe. The data of the current
+ * file that is read ahead counts as read, but the files after it do not.
+ */
+int inputPosition(unsigned long long *position, unsigned long long *size);
+
+#endif /* INPUT_H */
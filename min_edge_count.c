@@ -13,7 +13,7 @@
  *
  * Compile with:
  *
- *     cc -o min_edge_count -O4 min_edge_count.c
+ *     cc -o min_edge_count -O4 min_edge_count.c output.c stats.c progress.c input.c -pthread -lz -llzma
  *
  */
 
@@ -22,13 +22,19 @@
 #include <getopt.h>
 #include <string.h>
 
+#include "output.h"
+#include "stats.h"
+#include "progress.h"
+#include "input.h"
+#include <limits.h>
+
 
 #ifndef MAXN
-#define MAXN 12            /* the maximum number of vertices */
+#define MAXN 12            /* the initial maximum number of vertices */
 #endif
-#define MAXE (6*MAXN-12)    /* the maximum number of oriented edges */
-#define MAXVAL (MAXN-1)  /* the maximum degree of a vertex */
-#define MAXCODELENGTH (MAXN+MAXE+3)
+#define EDGECOUNT(n) (6*(n)-12)    /* the maximum number of oriented edges */
+#define MAXVAL (maxn-1)  /* the maximum degree of a vertex */
+#define CODELENGTH(n) ((n)+EDGECOUNT(n)+3)
 
 #define FALSE 0
 #define TRUE  1
@@ -44,20 +50,40 @@ typedef struct e /* The data type used for edges */ {
     struct e *inverse; /* the edge that is inverse to this one */
 } EDGE;
 
-EDGE *firstedge[MAXN]; /* pointer to arbitrary edge out of vertex i. */
-int degree[MAXN];
+/* The storage for the graphs is sized at runtime. The static arrays are used
+ * as long as the graphs have at most MAXN vertices. Once a larger graph is read
+ * (or a larger size is requested with --max-n) the storage moves to the heap,
+ * where it is reused for all later graphs.
+ */
+int maxn = MAXN; /* the number of vertices for which storage is available */
+
+EDGE *firstedgeStorage[MAXN];
+int degreeStorage[MAXN];
+EDGE edgesStorage[EDGECOUNT(MAXN)];
 
-EDGE edges[MAXE];
+EDGE **firstedge = firstedgeStorage; /* pointer to arbitrary edge out of vertex i. */
+int *degree = degreeStorage;
+
+EDGE *edges = edgesStorage;
 
 int numberOfGraphs = 0;
 
 int nv;
 int ne;
 
-int minEdgeCount = MAXE/2 + 1;
+int minEdgeCount = INT_MAX;
 int minEdgeNumberCount = 0;
 int numbers[10000];
 
+/* Writes the smallest number of edges so far for a progress report. */
+void reportMinEdgeCount(FILE *f){
+    int count = __atomic_load_n(&minEdgeNumberCount, __ATOMIC_RELAXED);
+    if(count){
+        fprintf(f, "The smallest number of edges so far is %d (%d graph%s).\n",
+                __atomic_load_n(&minEdgeCount, __ATOMIC_RELAXED), count, count==1 ? "" : "s");
+    }
+}
+
 void countEdges(){
     int i, sum = 0;
     for(i = 0; i < nv; i++){
@@ -74,6 +100,49 @@ void countEdges(){
     }
 }
 
+//=============== Graph storage ===========================
+
+/* Returns storage for count elements of the given size to replace current.
+ * The contents are not preserved. The initial storage is the static array,
+ * which is never freed.
+ */
+void *resizeStorage(void *current, void *initial, size_t count, size_t size){
+    if(current != initial){
+        free(current);
+    }
+    void *storage = malloc(count * size);
+    if(storage == NULL){
+        fprintf(stderr, "Insufficient memory for the graph storage -- exiting!\n");
+        exit(1);
+    }
+    return storage;
+}
+
+/* Makes sure that graphs with n vertices fit in the graph storage. The storage
+ * grows by at least half of its size to avoid repeated resizing when the
+ * graphs grow gradually.
+ */
+void ensureCapacity(int n){
+    if(n <= maxn) return;
+    if(n < maxn + maxn/2){
+        n = maxn + maxn/2;
+    }
+    firstedge = resizeStorage(firstedge, firstedgeStorage, n, sizeof(EDGE *));
+    degree = resizeStorage(degree, degreeStorage, n, sizeof(int));
+    edges = resizeStorage(edges, edgesStorage, EDGECOUNT(n), sizeof(EDGE));
+    maxn = n;
+}
+
+void growCodeBuffer(unsigned short **code, int *capacity, int newCapacity){
+    unsigned short *buffer = realloc(*code, newCapacity * sizeof(unsigned short));
+    if(buffer == NULL){
+        fprintf(stderr, "Insufficient memory for a code of length %d -- exiting!\n", newCapacity);
+        exit(1);
+    }
+    *code = buffer;
+    *capacity = newCapacity;
+}
+
 //=============== Reading and decoding planarcode ===========================
 
 EDGE *findEdge(int from, int to) {
@@ -100,6 +169,8 @@ void decodePlanarCode(unsigned short* code) {
     nv = code[0];
     codePosition = 1;
 
+    ensureCapacity(nv);
+
     for (i = 0; i < nv; i++) {
         degree[i] = 0;
         if(code[codePosition]){
@@ -144,20 +215,41 @@ void decodePlanarCode(unsigned short* code) {
     ne = edgeCounter;
 }
 
+/* Returns the next byte of a code or header. Exits if the input ends there,
+ * instead of storing EOF in the code and reading on forever.
+ */
+static inline unsigned short readCodeByte(FILE *file){
+    int c = getc(file);
+    if (c == EOF) {
+        fprintf(stderr, "The input ends in the middle of a graph -- exiting!\n");
+        exit(1);
+    }
+    return c;
+}
+
 /**
+ * Reads the next code into *codePointer. The buffer is (re)allocated when
+ * it is too small for the code and *codeCapacity is updated accordingly.
  *
- * @param code
+ * @param codePointer
+ * @param codeCapacity
  * @param length
  * @param file
  * @return returns 1 if a code was read and 0 otherwise. Exits in case of error.
  */
-int readPlanarCode(unsigned short code[], int *length, FILE *file) {
+int readPlanarCode(unsigned short **codePointer, int *codeCapacity, int *length, FILE *file) {
     static int first = 1;
     unsigned char c;
     char testheader[20];
     int bufferSize, zeroCounter;
 
     int readCount;
+    unsigned short *code;
+
+    if (*codeCapacity < CODELENGTH(maxn)) {
+        growCodeBuffer(codePointer, codeCapacity, CODELENGTH(maxn));
+    }
+    code = *codePointer;
 
 
     if (first) {
@@ -200,16 +292,16 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
         code[0] = c;
         bufferSize = 1;
         zeroCounter = 0;
-        code[1] = (unsigned short) getc(file);
+        code[1] = readCodeByte(file);
         if (code[1] == 0) zeroCounter++;
-        code[2] = (unsigned short) getc(file);
+        code[2] = readCodeByte(file);
         if (code[2] == 0) zeroCounter++;
         bufferSize = 3;
         // 3 characters were read and stored in buffer
         if ((code[1] == '>') && (code[2] == 'p')) /*we are sure that we're dealing with a header*/ {
-            while ((c = getc(file)) != '<');
+            while ((c = readCodeByte(file)) != '<');
             /* read 2 more characters: */
-            c = getc(file);
+            c = readCodeByte(file);
             if (c != '<') {
                 fprintf(stderr, "Problems with header -- single '<'\n");
                 exit(1);
@@ -229,12 +321,16 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
 
     if (c != 0) /* unsigned chars would be sufficient */ {
         code[0] = c;
-        if (code[0] > MAXN) {
-            fprintf(stderr, "Constant N too small %d > %d \n", code[0], MAXN);
-            exit(1);
+        if (*codeCapacity < CODELENGTH(code[0])) {
+            growCodeBuffer(codePointer, codeCapacity, CODELENGTH(code[0]));
+            code = *codePointer;
         }
         while (zeroCounter < code[0]) {
-            code[bufferSize] = (unsigned short) getc(file);
+            if (bufferSize == *codeCapacity) {
+                growCodeBuffer(codePointer, codeCapacity, 2 * *codeCapacity);
+                code = *codePointer;
+            }
+            code[bufferSize] = readCodeByte(file);
             if (code[bufferSize] == 0) zeroCounter++;
             bufferSize++;
         }
@@ -244,13 +340,17 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
             fprintf(stderr, "Unexpected EOF.\n");
             exit(1);
         }
-        if (code[0] > MAXN) {
-            fprintf(stderr, "Constant N too small %d > %d \n", code[0], MAXN);
-            exit(1);
+        if (*codeCapacity < CODELENGTH(code[0])) {
+            growCodeBuffer(codePointer, codeCapacity, CODELENGTH(code[0]));
+            code = *codePointer;
         }
         bufferSize = 1;
         zeroCounter = 0;
         while (zeroCounter < code[0]) {
+            if (bufferSize == *codeCapacity) {
+                growCodeBuffer(codePointer, codeCapacity, 2 * *codeCapacity);
+                code = *codePointer;
+            }
             readCount = fread(code + bufferSize, sizeof (unsigned short), 1, file);
             if(!readCount){
                 fprintf(stderr, "Unexpected EOF.\n");
@@ -272,16 +372,28 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
 void help(char *name) {
     fprintf(stderr, "The program %s counts edges in planar graphs.\n\n", name);
     fprintf(stderr, "Usage\n=====\n");
-    fprintf(stderr, " %s [options]\n\n", name);
-    fprintf(stderr, "\nThis program can handle graphs up to %d vertices. Recompile if you need larger\n", MAXN);
-    fprintf(stderr, "graphs.\n\n");
+    fprintf(stderr, " %s [options] [file ...]\n\n", name);
+    fprintf(stderr, "\nThe graphs are read from the given files one after the other, or from\n");
+    fprintf(stderr, "standard in if no files are given.\n");
+    fprintf(stderr, "The storage for the graphs grows when larger graphs are read. Use the\n");
+    fprintf(stderr, "option --max-n to allocate it for a given number of vertices in advance.\n\n");
     fprintf(stderr, "Valid options\n=============\n");
     fprintf(stderr, "    -h, --help\n");
     fprintf(stderr, "       Print this help and return.\n");
+    fprintf(stderr, "    -m, --max-n n\n");
+    fprintf(stderr, "       Allocate the storage for graphs with up to n vertices at the start.\n");
+    fprintf(stderr, "    --stats[=file]\n");
+    fprintf(stderr, "       Write statistics about this run (time per stage, throughput and graph\n");
+    fprintf(stderr, "       sizes) in JSON to stderr or to the given file.\n");
+    fprintf(stderr, "    --progress seconds\n");
+    fprintf(stderr, "       Report the progress every given number of seconds. A report is also\n");
+    fprintf(stderr, "       written to stderr when the program receives SIGUSR1.\n");
+    fprintf(stderr, "    --async-input\n");
+    fprintf(stderr, "       Read the input on a separate thread, so reading and processing overlap.\n");
 }
 
 void usage(char *name) {
-    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "Usage: %s [options] [file ...]\n", name);
     fprintf(stderr, "For more information type: %s -h \n\n", name);
 }
 
@@ -292,15 +404,39 @@ int main(int argc, char *argv[]) {
     int c, i;
     char *name = argv[0];
     static struct option long_options[] = {
-        {"help", no_argument, NULL, 'h'}
+        {"help", no_argument, NULL, 'h'},
+        {"max-n", required_argument, NULL, 'm'},
+        {"stats", optional_argument, NULL, 'S'},
+        {"progress", required_argument, NULL, 'T'},
+        {"async-input", no_argument, NULL, 'A'},
+        {NULL, 0, NULL, 0}
     };
     int option_index = 0;
+    int progressInterval = 0;
+    boolean asyncInput = FALSE;
 
-    while ((c = getopt_long(argc, argv, "h", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "hm:", long_options, &option_index)) != -1) {
         switch (c) {
             case 'h':
                 help(name);
                 return EXIT_SUCCESS;
+            case 'm':
+                ensureCapacity(atoi(optarg));
+                break;
+            case 'S':
+                initStats(optarg);
+                break;
+            case 'A':
+                asyncInput = TRUE;
+                break;
+            case 'T':
+                progressInterval = atoi(optarg);
+                if(progressInterval < 1){
+                    fprintf(stderr, "The progress interval should be positive.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
             case '?':
                 usage(name);
                 return EXIT_FAILURE;
@@ -313,25 +449,45 @@ int main(int argc, char *argv[]) {
 
     /*=========== read planar graphs ===========*/
 
-    unsigned short code[MAXCODELENGTH];
+    startProgress(&numberOfGraphs, progressInterval, reportMinEdgeCount);
+    FILE *input = optind < argc ?
+            openInputFiles(argv + optind, argc - optind, asyncInput) : openInput(0, asyncInput);
+
+    unsigned short *code = NULL;
+    int codeCapacity = 0;
     int length;
-    while (readPlanarCode(code, &length, stdin)) {
+    startGraph();
+    while (readPlanarCode(&code, &codeCapacity, &length, input)) {
+        markStage(STAGE_READ);
         decodePlanarCode(code);
+        recordGraph(nv, ne, length);
+        markStage(STAGE_DECODE);
         numberOfGraphs++;
         countEdges();
+        markStage(STAGE_ANALYSIS);
+        startGraph();
     }
 
+    startSection();
+
     //print graphs with smallest number of edges
-    if(minEdgeCount >= 6){
-        fprintf(stdout, "(%d) %d", minEdgeCount, numbers[0]);
+    if(minEdgeNumberCount && minEdgeCount >= 6){
+        writeByte('(');
+        writeInt(minEdgeCount);
+        writeString(") ");
+        writeInt(numbers[0]);
         for(i = 1; i < minEdgeNumberCount; i++){
-            fprintf(stdout, ", %d", numbers[i]);
+            writeString(", ");
+            writeInt(numbers[i]);
         }
-        fprintf(stdout, "\n");
+        writeByte('\n');
     }
+    flushOutput();
+    markStage(STAGE_OUTPUT);
 
     fprintf(stderr, "Read %d graph%s.\n", numberOfGraphs,
                 numberOfGraphs==1 ? "" : "s");
+    finishStats();
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,266 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <zlib.h>
+
+#include "output.h"
+
+/* The buffer starts out full, so the first write triggers a flush, which
+ * allocates the buffer.
+ */
+__thread OUTPUTBUFFER outputBuffer = {1, NULL, OUTPUTBUFFERSIZE, 0, NULL};
+
+void appendBytes(BYTEBUFFER *block, const void *data, size_t length){
+    if(block->length + length > block->capacity){
+        size_t capacity = block->capacity ? 2*block->capacity : OUTPUTBUFFERSIZE/16;
+        while(capacity < block->length + length){
+            capacity *= 2;
+        }
+        unsigned char *grown = realloc(block->data, capacity);
+        if(grown == NULL){
+            fprintf(stderr, "Insufficient memory for the output -- exiting!\n");
+            exit(1);
+        }
+        block->data = grown;
+        block->capacity = capacity;
+    }
+    memcpy(block->data + block->length, data, length);
+    block->length += length;
+}
+
+/* Writes all the given parts, continuing after partial writes. */
+static void writeParts(int fd, struct iovec *parts, int partCount){
+    int i;
+    if(outputBuffer.capture != NULL){
+        for(i = 0; i < partCount; i++){
+            appendBytes(outputBuffer.capture, parts[i].iov_base, parts[i].iov_len);
+        }
+        return;
+    }
+    for(i = 0; i < partCount; i++){
+        outputBuffer.written += parts[i].iov_len;
+    }
+    while(partCount){
+        ssize_t written = writev(fd, parts, partCount);
+        if(written < 0){
+            if(errno == EINTR) continue;
+            fprintf(stderr, "Error while writing output -- exiting!\n");
+            exit(1);
+        }
+        while(partCount && written >= (ssize_t)parts->iov_len){
+            written -= parts->iov_len;
+            parts++;
+            partCount--;
+        }
+        if(partCount){
+            parts->iov_base = (char *)parts->iov_base + written;
+            parts->iov_len -= written;
+        }
+    }
+}
+
+void flushOutput(){
+    if(outputBuffer.data == NULL){
+        outputBuffer.data = malloc(OUTPUTBUFFERSIZE);
+        if(outputBuffer.data == NULL){
+            fprintf(stderr, "Insufficient memory for the output buffer -- exiting!\n");
+            exit(1);
+        }
+    } else if(outputBuffer.position){
+        struct iovec part = {outputBuffer.data, outputBuffer.position};
+        writeParts(outputBuffer.fd, &part, 1);
+    }
+    outputBuffer.position = 0;
+}
+
+void writeBytes(const void *data, size_t length){
+    if(length == 0){
+        return;
+    } else if(length <= OUTPUTBUFFERSIZE - outputBuffer.position){
+        memcpy(outputBuffer.data + outputBuffer.position, data, length);
+        outputBuffer.position += length;
+    } else if(length < OUTPUTBUFFERSIZE/2 || outputBuffer.data == NULL){
+        flushOutput();
+        writeBytes(data, length);
+    } else {
+        struct iovec parts[2] = {
+            {outputBuffer.data, outputBuffer.position},
+            {(void *)data, length}
+        };
+        writeParts(outputBuffer.fd, parts, 2);
+        outputBuffer.position = 0;
+    }
+}
+
+void writeString(const char *s){
+    writeBytes(s, strlen(s));
+}
+
+/* Stores the digits of value in reverse order in digits and returns the
+ * number of digits.
+ */
+static int formatDigits(unsigned long long value, char *digits){
+    int count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while(value);
+    return count;
+}
+
+void writePaddedInt(long long value, int width){
+    char digits[24];
+    int negative = value < 0;
+    int count = formatDigits(negative ? -(unsigned long long)value : value, digits);
+    int length = count + negative;
+
+    if(width > 64) width = 64;
+    if(outputBuffer.position + (length > width ? length : width) > OUTPUTBUFFERSIZE){
+        flushOutput();
+    }
+
+    unsigned char *p = outputBuffer.data + outputBuffer.position;
+    for(; width > length; width--){
+        *p++ = ' ';
+    }
+    if(negative){
+        *p++ = '-';
+    }
+    while(count){
+        *p++ = digits[--count];
+    }
+    outputBuffer.position = p - outputBuffer.data;
+}
+
+void writeInt(long long value){
+    writePaddedInt(value, 0);
+}
+
+void writePlanarCode(const unsigned short *code, int length){
+    int i;
+    if(code[0] + 1 <= 255){
+        for(i = 0; i < length; i++){
+            writeByte(code[i]);
+        }
+    } else {
+        writeByte(0);
+        for(i = 0; i < length; i++){
+            writeShort(code[i]);
+        }
+    }
+}
+
+//=============== Compressed output ===========================
+
+int compressionLevel = 0;
+static FILE *frameTable = NULL;
+static BYTEBUFFER pendingFrame; /* the frame that the main thread is writing */
+
+/* The position of the next frame. Frames are written by one thread at a time. */
+static unsigned long long compressedOffset = 0;
+static unsigned long long uncompressedOffset = 0;
+static unsigned long long graphOffset = 0;
+
+void startCompressedOutput(int level, const char *frameTableName){
+    compressionLevel = level;
+    if(frameTableName != NULL){
+        frameTable = fopen(frameTableName, "w");
+        if(frameTable == NULL){
+            fprintf(stderr, "Could not open the frame table %s -- exiting!\n", frameTableName);
+            exit(1);
+        }
+        fprintf(frameTable, "# compressed_offset compressed_length uncompressed_offset"
+                " uncompressed_length first_graph graphs\n");
+    }
+    flushOutput();
+    outputBuffer.capture = &pendingFrame;
+}
+
+void compressBlock(BYTEBUFFER *block){
+    static __thread z_stream stream;
+    static __thread int initialised = 0;
+    static __thread BYTEBUFFER compressed;
+
+    if(!initialised){
+        //15 + 16: the largest window and a gzip header
+        if(deflateInit2(&stream, compressionLevel, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK){
+            fprintf(stderr, "Could not start the compression of the output -- exiting!\n");
+            exit(1);
+        }
+        initialised = 1;
+    } else {
+        deflateReset(&stream);
+    }
+
+    size_t bound = deflateBound(&stream, block->length);
+    if(bound > compressed.capacity){
+        free(compressed.data);
+        compressed.data = malloc(bound);
+        compressed.capacity = bound;
+        if(compressed.data == NULL){
+            fprintf(stderr, "Insufficient memory for the output -- exiting!\n");
+            exit(1);
+        }
+    }
+    stream.next_in = block->data;
+    stream.avail_in = block->length;
+    stream.next_out = compressed.data;
+    stream.avail_out = compressed.capacity;
+    if(deflate(&stream, Z_FINISH) != Z_STREAM_END){
+        fprintf(stderr, "Error while compressing the output -- exiting!\n");
+        exit(1);
+    }
+    compressed.length = stream.total_out;
+
+    BYTEBUFFER swap = *block;
+    *block = compressed;
+    compressed = swap;
+}
+
+void writeFrame(BYTEBUFFER *frame, size_t uncompressedLength, int graphCount){
+    if(frame->length == 0){
+        return;
+    }
+    if(frameTable != NULL){
+        fprintf(frameTable, "%llu %zu %llu %zu %llu %d\n", compressedOffset, frame->length,
+                uncompressedOffset, uncompressedLength, graphOffset + 1, graphCount);
+    }
+    compressedOffset += frame->length;
+    uncompressedOffset += uncompressedLength;
+    graphOffset += graphCount;
+
+    BYTEBUFFER *capture = outputBuffer.capture;
+    struct iovec part = {frame->data, frame->length};
+    outputBuffer.capture = NULL;
+    writeParts(outputBuffer.fd, &part, 1);
+    outputBuffer.capture = capture;
+}
+
+void endFrame(unsigned long long graphTotal){
+    flushOutput();
+    size_t uncompressedLength = pendingFrame.length;
+    if(uncompressedLength){
+        compressBlock(&pendingFrame);
+        writeFrame(&pendingFrame, uncompressedLength, graphTotal - graphOffset);
+        pendingFrame.length = 0;
+    }
+}
+
+void finishCompressedOutput(unsigned long long graphTotal){
+    endFrame(graphTotal);
+    outputBuffer.capture = NULL;
+    if(frameTable != NULL && fclose(frameTable)){
+        fprintf(stderr, "Could not write the frame table -- exiting!\n");
+        exit(1);
+    }
+}
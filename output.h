@@ -0,0 +1,118 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+/* Buffered output that is shared by all programs. Everything that is written
+ * to standard out is collected in a large buffer that belongs to the current
+ * thread. Integers are formatted by hand, and the buffer is flushed with
+ * writev so that large blocks are written without copying them first.
+ *
+ * Data written with these functions bypasses stdio, so a program should not
+ * mix them with writes to stdout.
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+
+#define OUTPUTBUFFERSIZE (1<<20)
+
+/* A growable block of memory. */
+typedef struct {
+    unsigned char *data;
+    size_t length;
+    size_t capacity;
+} BYTEBUFFER;
+
+typedef struct {
+    int fd; /* the file descriptor to which the buffer is flushed */
+    unsigned char *data; /* allocated on the first flush */
+    size_t position;
+    unsigned long long written; /* the number of bytes written to fd so far */
+    BYTEBUFFER *capture; /* if not NULL, the output is appended to this block
+                            instead of being written to fd */
+} OUTPUTBUFFER;
+
+extern __thread OUTPUTBUFFER outputBuffer;
+
+/* Writes the contents of the buffer. */
+void flushOutput();
+
+/* Appends length bytes from data to the block. */
+void appendBytes(BYTEBUFFER *block, const void *data, size_t length);
+
+/* Writes length bytes from data. Blocks that do not fit in the buffer are
+ * written together with the buffer in a single call to writev.
+ */
+void writeBytes(const void *data, size_t length);
+
+void writeString(const char *s);
+
+/* Writes value in decimal notation. */
+void writeInt(long long value);
+
+/* Writes value in decimal notation, right aligned in a field of the given
+ * width (like %8d for a width of 8).
+ */
+void writePaddedInt(long long value, int width);
+
+static inline void writeByte(unsigned char c){
+    if(outputBuffer.position == OUTPUTBUFFERSIZE){
+        flushOutput();
+    }
+    outputBuffer.data[outputBuffer.position++] = c;
+}
+
+/* Writes a 16-bit value in little endian byte order. */
+static inline void writeShort(unsigned short s){
+    if(outputBuffer.position + 2 > OUTPUTBUFFERSIZE){
+        flushOutput();
+    }
+    outputBuffer.data[outputBuffer.position++] = s & 0xFF;
+    outputBuffer.data[outputBuffer.position++] = s >> 8;
+}
+
+/* Writes a code as returned by readPlanarCode in planar code (without a
+ * header). Graphs with more than 254 vertices are written with 16-bit little
+ * endian values, as fullgen does.
+ */
+void writePlanarCode(const unsigned short *code, int length);
+
+/* Compressed output. The output is split in frames, which are compressed
+ * independently as gzip members. The members can be compressed on several
+ * threads and decompressed from any frame on; gzip and the programs read them
+ * as a single stream. The frame table is a text file with one line per frame
+ * with its offset and length in the compressed and in the uncompressed output,
+ * the rank of its first graph and its number of graphs.
+ */
+
+/* The compression level, or 0 if the output is not compressed. */
+extern int compressionLevel;
+
+/* Compresses everything that the main thread writes from now on. If
+ * frameTableName is not NULL, the frame table is written to that file.
+ */
+void startCompressedOutput(int level, const char *frameTableName);
+
+/* Replaces the contents of the block by a gzip member with these contents. */
+void compressBlock(BYTEBUFFER *block);
+
+/* Writes a compressed frame that contains graphCount graphs. Frames must be
+ * written by one thread at a time.
+ */
+void writeFrame(BYTEBUFFER *frame, size_t uncompressedLength, int graphCount);
+
+/* Compresses and writes what the main thread wrote since the previous frame.
+ * graphTotal is the number of graphs written so far, including the graphs in
+ * this frame.
+ */
+void endFrame(unsigned long long graphTotal);
+
+/* Writes the last frame and closes the frame table. */
+void finishCompressedOutput(unsigned long long graphTotal);
+
+#endif /* OUTPUT_H */
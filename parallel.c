@@ -0,0 +1,411 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "parallel.h"
+#include "stats.h"
+
+/* The states of a batch. */
+#define FREE 0
+#define QUEUED 1
+#define ANALYSED 2
+
+/* A queue to which only the reader adds batches and from which all workers
+ * take them. It never holds more than all batches, so its size does not need
+ * to grow.
+ */
+typedef struct {
+    long long top;
+    char padding[64 - sizeof(long long)]; /* keep top and bottom apart */
+    long long bottom;
+    BATCH **items;
+    int capacity;
+} QUEUE;
+
+static int workerCount;
+static PARALLELANALYSIS *currentAnalysis;
+static int codesPerGraph;
+
+static BATCH *batches;
+static int batchCount;
+static QUEUE *queues;
+
+static unsigned int workSignal = 0; /* changes whenever work is added */
+static int sleepingWorkers = 0;
+static int readingFinished = 0;
+
+static long long nextToWrite = 0;
+static int writerActive = 0;
+
+static pthread_mutex_t finishLock = PTHREAD_MUTEX_INITIALIZER;
+
+const char *unorderedPrefix = NULL;
+
+/* The totals of the unordered output of each worker, for the manifest. */
+typedef struct {
+    long long records;
+    long long graphs;
+    unsigned long long bytes;
+} UNORDEREDFILE;
+
+static UNORDEREDFILE *unorderedFiles;
+
+static void waitWhileEqual(unsigned int *address, unsigned int value){
+    syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void wakeWaiters(unsigned int *address){
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+static void addBatch(QUEUE *queue, BATCH *batch){
+    long long bottom = __atomic_load_n(&queue->bottom, __ATOMIC_RELAXED);
+    queue->items[bottom % queue->capacity] = batch;
+    __atomic_store_n(&queue->bottom, bottom + 1, __ATOMIC_RELEASE);
+}
+
+/* Returns the oldest batch in the queue, or NULL if it is empty. */
+static BATCH *takeBatch(QUEUE *queue){
+    while(1){
+        long long top = __atomic_load_n(&queue->top, __ATOMIC_ACQUIRE);
+        long long bottom = __atomic_load_n(&queue->bottom, __ATOMIC_ACQUIRE);
+        if(top >= bottom){
+            return NULL;
+        }
+        BATCH *batch = queue->items[top % queue->capacity];
+        if(__atomic_compare_exchange_n(&queue->top, &top, top + 1, 0,
+                __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)){
+            return batch;
+        }
+    }
+}
+
+/* Looks for work in the own queue first, and then in the others. */
+static BATCH *findWork(int worker){
+    int i;
+    for(i = 0; i < workerCount; i++){
+        BATCH *batch = takeBatch(queues + (worker + i) % workerCount);
+        if(batch != NULL){
+            return batch;
+        }
+    }
+    return NULL;
+}
+
+/* Writes the analysed batches in order. Only one thread writes at a time;
+ * a thread that finds another one writing leaves its batch to that thread.
+ *
+ * A worker stores ANALYSED and then tries to become the writer, while the
+ * writer clears writerActive and then checks the next batch again. Both are a
+ * store followed by a load of the other variable, so these accesses are
+ * sequentially consistent: otherwise each thread could miss the store of the
+ * other one and the batch would never be written.
+ */
+static void writeAnalysedBatches(){
+    while(1){
+        if(__atomic_exchange_n(&writerActive, 1, __ATOMIC_SEQ_CST)){
+            break;
+        }
+        long long next = __atomic_load_n(&nextToWrite, __ATOMIC_RELAXED);
+        BATCH *batch = batches + next % batchCount;
+        while(__atomic_load_n(&batch->state, __ATOMIC_ACQUIRE) == ANALYSED &&
+                batch->sequence == next){
+            if(compressionLevel){
+                writeFrame(&batch->output, batch->uncompressedLength,
+                        batch->count / codesPerGraph);
+            } else {
+                writeBytes(batch->output.data, batch->output.length);
+            }
+            batch->output.length = 0;
+            next++;
+            __atomic_store_n(&nextToWrite, next, __ATOMIC_RELAXED);
+            __atomic_store_n(&batch->state, FREE, __ATOMIC_RELEASE);
+            wakeWaiters(&batch->state);
+            batch = batches + next % batchCount;
+        }
+        flushOutput();
+        __atomic_store_n(&writerActive, 0, __ATOMIC_SEQ_CST);
+
+        //another thread may have finished the next batch while we were writing
+        next = __atomic_load_n(&nextToWrite, __ATOMIC_SEQ_CST);
+        batch = batches + next % batchCount;
+        if(__atomic_load_n(&batch->state, __ATOMIC_SEQ_CST) != ANALYSED ||
+                batch->sequence != next){
+            break;
+        }
+    }
+}
+
+void startUnorderedOutput(const char *prefix){
+    unorderedPrefix = prefix;
+}
+
+/* Returns the name of a file with unordered output (with the given suffix). */
+static char *unorderedFileName(const char *suffix){
+    char *name = malloc(strlen(unorderedPrefix) + strlen(suffix) + 2);
+    if(name == NULL){
+        fprintf(stderr, "Insufficient memory for the parallel analysis -- exiting!\n");
+        exit(1);
+    }
+    sprintf(name, "%s.%s", unorderedPrefix, suffix);
+    return name;
+}
+
+/* Appends the output of the batch as a record to the file of this worker. */
+static void writeUnorderedBatch(BATCH *batch, UNORDEREDFILE *file){
+    UNORDEREDRECORD record;
+    record.firstRank = batch->firstGraph + 1;
+    record.graphCount = batch->count / codesPerGraph;
+    record.length = batch->output.length;
+    writeBytes(&record, sizeof(UNORDEREDRECORD));
+    writeBytes(batch->output.data, batch->output.length);
+    //the next batch is captured from an empty buffer
+    flushOutput();
+    batch->output.length = 0;
+    file->records++;
+    file->graphs += record.graphCount;
+}
+
+static void writeManifest(){
+    int i;
+    char *name = unorderedFileName("manifest");
+    FILE *manifest = fopen(name, "w");
+    if(manifest == NULL){
+        fprintf(stderr, "Could not open %s -- exiting!\n", name);
+        exit(1);
+    }
+    fprintf(manifest, "# file records graphs bytes\n");
+    for(i = 0; i < workerCount; i++){
+        fprintf(manifest, "%s.%d %lld %lld %llu\n", unorderedPrefix, i,
+                unorderedFiles[i].records, unorderedFiles[i].graphs, unorderedFiles[i].bytes);
+    }
+    if(fclose(manifest)){
+        fprintf(stderr, "Could not write %s -- exiting!\n", name);
+        exit(1);
+    }
+    free(name);
+}
+
+static void *worker(void *arg){
+    int id = (int)(long)arg;
+
+    initWorkerStats();
+    if(currentAnalysis->initWorker != NULL){
+        currentAnalysis->initWorker(id);
+    }
+    if(unorderedPrefix != NULL){
+        char suffix[16];
+        sprintf(suffix, "%d", id);
+        char *name = unorderedFileName(suffix);
+        outputBuffer.fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(outputBuffer.fd < 0){
+            fprintf(stderr, "Could not open %s -- exiting!\n", name);
+            exit(1);
+        }
+        free(name);
+    }
+
+    while(1){
+        BATCH *batch = findWork(id);
+        if(batch == NULL){
+            //announce that we are going to sleep before the final check
+            __atomic_add_fetch(&sleepingWorkers, 1, __ATOMIC_SEQ_CST);
+            unsigned int signal = __atomic_load_n(&workSignal, __ATOMIC_SEQ_CST);
+            int finished = __atomic_load_n(&readingFinished, __ATOMIC_SEQ_CST);
+            batch = findWork(id);
+            if(batch == NULL){
+                if(finished){
+                    __atomic_sub_fetch(&sleepingWorkers, 1, __ATOMIC_SEQ_CST);
+                    break;
+                }
+                waitWhileEqual(&workSignal, signal);
+            }
+            __atomic_sub_fetch(&sleepingWorkers, 1, __ATOMIC_SEQ_CST);
+            if(batch == NULL){
+                continue;
+            }
+        }
+
+        outputBuffer.capture = &batch->output;
+        currentAnalysis->analyseBatch(batch);
+        flushOutput();
+        outputBuffer.capture = NULL;
+        if(unorderedPrefix != NULL){
+            writeUnorderedBatch(batch, unorderedFiles + id);
+            __atomic_store_n(&batch->state, FREE, __ATOMIC_RELEASE);
+            wakeWaiters(&batch->state);
+            continue;
+        }
+        if(compressionLevel){
+            batch->uncompressedLength = batch->output.length;
+            compressBlock(&batch->output);
+        }
+
+        //sequentially consistent, see writeAnalysedBatches
+        __atomic_store_n(&batch->state, ANALYSED, __ATOMIC_SEQ_CST);
+        writeAnalysedBatches();
+    }
+
+    if(unorderedPrefix != NULL){
+        flushOutput();
+        unorderedFiles[id].bytes = outputBuffer.written;
+        if(close(outputBuffer.fd)){
+            fprintf(stderr, "Could not write the unordered output -- exiting!\n");
+            exit(1);
+        }
+        outputBuffer.fd = 1;
+    }
+
+    pthread_mutex_lock(&finishLock);
+    mergeWorkerStats();
+    if(currentAnalysis->finishWorker != NULL){
+        currentAnalysis->finishWorker(id);
+    }
+    pthread_mutex_unlock(&finishLock);
+    return NULL;
+}
+
+static void signalWork(){
+    __atomic_add_fetch(&workSignal, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&sleepingWorkers, __ATOMIC_SEQ_CST)){
+        wakeWaiters(&workSignal);
+    }
+}
+
+static void *allocateParallel(size_t count, size_t size){
+    void *storage = calloc(count, size);
+    if(storage == NULL){
+        fprintf(stderr, "Insufficient memory for the parallel analysis -- exiting!\n");
+        exit(1);
+    }
+    return storage;
+}
+
+void analyseInParallel(FILE *input, int threadCount, PARALLELANALYSIS *analysis,
+        int *graphCounter){
+    int i;
+    pthread_t *threads = allocateParallel(threadCount, sizeof(pthread_t));
+
+    workerCount = threadCount;
+    currentAnalysis = analysis;
+    codesPerGraph = analysis->codesPerGraph ? analysis->codesPerGraph : 1;
+    batchCount = BATCHESPERTHREAD * threadCount;
+    batches = allocateParallel(batchCount, sizeof(BATCH));
+    for(i = 0; i < batchCount; i++){
+        batches[i].codeStart = allocateParallel(BATCHGRAPHS + 1, sizeof(int));
+    }
+    if(unorderedPrefix != NULL){
+        unorderedFiles = allocateParallel(threadCount, sizeof(UNORDEREDFILE));
+    }
+    queues = allocateParallel(threadCount, sizeof(QUEUE));
+    for(i = 0; i < threadCount; i++){
+        queues[i].capacity = batchCount;
+        queues[i].items = allocateParallel(batchCount, sizeof(BATCH *));
+    }
+
+    //make sure the output so far is written before the workers start
+    if(compressionLevel){
+        endFrame(*graphCounter);
+    } else {
+        flushOutput();
+    }
+
+    for(i = 0; i < threadCount; i++){
+        if(pthread_create(threads + i, NULL, worker, (void *)(long)i)){
+            fprintf(stderr, "Could not start the worker threads -- exiting!\n");
+            exit(1);
+        }
+    }
+
+    unsigned short *code = NULL;
+    int codeCapacity = 0;
+    int length;
+    int graphs = 0;
+    long long sequence;
+    int more = 1;
+    for(sequence = 0; more; sequence++){
+        BATCH *batch = batches + sequence % batchCount;
+        unsigned int state;
+        while((state = __atomic_load_n(&batch->state, __ATOMIC_ACQUIRE)) != FREE){
+            waitWhileEqual(&batch->state, state);
+        }
+
+        batch->sequence = sequence;
+        batch->firstGraph = graphs;
+        batch->count = 0;
+        batch->codeStart[0] = 0;
+        startGraph();
+        while(batch->count < BATCHGRAPHS &&
+                (more = readPlanarCode(&code, &codeCapacity, &length, input))){
+            markStage(STAGE_READ);
+            if(batch->count % codesPerGraph == 0){
+                recordGraph(code[0], length - code[0] - 1, length);
+            }
+            int start = batch->codeStart[batch->count];
+            if(start + length > batch->codesCapacity){
+                int capacity = 2*(start + length);
+                batch->codes = realloc(batch->codes, capacity * sizeof(unsigned short));
+                if(batch->codes == NULL){
+                    fprintf(stderr, "Insufficient memory for a batch -- exiting!\n");
+                    exit(1);
+                }
+                batch->codesCapacity = capacity;
+            }
+            memcpy(batch->codes + start, code, length * sizeof(unsigned short));
+            batch->count++;
+            batch->codeStart[batch->count] = start + length;
+            startGraph();
+        }
+        if(batch->count % codesPerGraph){
+            fprintf(stderr, "The input ends in the middle of a graph -- exiting!\n");
+            exit(1);
+        }
+        if(batch->count == 0){
+            break;
+        }
+        graphs += batch->count / codesPerGraph;
+        __atomic_store_n(graphCounter, graphs, __ATOMIC_RELAXED);
+
+        __atomic_store_n(&batch->state, QUEUED, __ATOMIC_RELAXED);
+        addBatch(queues + sequence % threadCount, batch);
+        signalWork();
+    }
+    free(code);
+
+    __atomic_store_n(&readingFinished, 1, __ATOMIC_SEQ_CST);
+    signalWork();
+    wakeWaiters(&workSignal);
+
+    for(i = 0; i < threadCount; i++){
+        pthread_join(threads[i], NULL);
+    }
+    if(unorderedPrefix != NULL){
+        writeManifest();
+        free(unorderedFiles);
+    }
+
+    for(i = 0; i < batchCount; i++){
+        free(batches[i].codes);
+        free(batches[i].codeStart);
+        free(batches[i].output.data);
+    }
+    for(i = 0; i < threadCount; i++){
+        free(queues[i].items);
+    }
+    free(batches);
+    free(queues);
+    free(threads);
+}
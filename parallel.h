@@ -0,0 +1,97 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+/* Parallel analysis of a stream of graphs with a pool of worker threads
+ * (producer/consumer). The calling thread is the only producer: it reads and
+ * parses all codes with readPlanarCode and copies them into batches, which
+ * are the unit of work. The batches are added in turn to one queue per worker.
+ * A worker takes batches from its own queue first and from the other queues
+ * when its own is empty, so no single queue is shared by all threads.
+ *
+ * Since all input is parsed on one thread, the reader limits the speedup when
+ * the analysis of a graph is cheap compared to reading it.
+ *
+ * Everything a worker writes with the functions from output.h while analysing
+ * a batch is stored with the batch, and the batches are written in the order
+ * in which they were read. Counters should be kept per thread and merged in
+ * finishWorker. With compressed output, each worker compresses the output of
+ * its batches, which are written as separate frames.
+ *
+ * With unordered output the order of the input is not kept: each worker
+ * appends the output of its batches to a file of its own as soon as a batch is
+ * analysed, so no batch waits for the batches before it. The output of a batch
+ * is written as a record: an UNORDEREDRECORD followed by the output of the
+ * graphs in the batch, in the order of the input. A manifest lists the files
+ * with their number of records, graphs and bytes.
+ *
+ * The program state that is used to analyse a graph must be thread-local.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdio.h>
+
+#include "output.h"
+
+#define BATCHGRAPHS 512 /* the maximum number of codes in a batch (even) */
+#define BATCHESPERTHREAD 4 /* the number of batches in flight per worker */
+
+typedef struct {
+    long long sequence; /* the number of the batch in the input */
+    int firstGraph; /* the number of graphs before this batch */
+    int count; /* the number of codes in this batch */
+    unsigned short *codes; /* the codes, one after the other */
+    int codesCapacity;
+    int *codeStart; /* the code of graph i starts at codes + codeStart[i] */
+    BYTEBUFFER output;
+    size_t uncompressedLength; /* the length of the output before compression */
+    unsigned int state;
+} BATCH;
+
+typedef struct {
+    /* Called on each worker thread before it analyses its first batch. */
+    void (*initWorker)(int worker);
+    /* Analyses all graphs in the batch. */
+    void (*analyseBatch)(BATCH *batch);
+    /* Called on each worker thread after the last batch. These calls never
+     * run at the same time, so they can merge counters into shared totals.
+     */
+    void (*finishWorker)(int worker);
+    /* The number of codes per graph: 0 or 1, or 2 when each pentagon
+     * partition is followed by its original graph. A batch then contains
+     * count/2 graphs and never ends between the codes of a graph.
+     */
+    int codesPerGraph;
+} PARALLELANALYSIS;
+
+typedef struct {
+    unsigned long long firstRank; /* the rank of the first graph in the record */
+    unsigned int graphCount;
+    unsigned int length; /* the number of bytes of output that follow */
+} UNORDEREDRECORD;
+
+/* The prefix of the files with unordered output, or NULL. */
+extern const char *unorderedPrefix;
+
+/* Writes the output of the next call to analyseInParallel unordered to the
+ * files prefix.0, prefix.1, ... (one per worker), and the manifest to
+ * prefix.manifest.
+ */
+void startUnorderedOutput(const char *prefix);
+
+/* Reads all codes from input and analyses them on threadCount worker threads.
+ * graphCounter is updated with the number of graphs read so far. Returns when
+ * all batches have been analysed and written.
+ */
+void analyseInParallel(FILE *input, int threadCount, PARALLELANALYSIS *analysis,
+        int *graphCounter);
+
+/* Provided by the program. */
+int readPlanarCode(unsigned short **codePointer, int *codeCapacity, int *length, FILE *file);
+
+#endif /* PARALLEL_H */
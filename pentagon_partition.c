@@ -11,7 +11,7 @@
  * 
  * Compile with:
  *     
- *     cc -o pentagon_partition -O4 pentagon_partition.c
+ *     cc -o pentagon_partition -O4 pentagon_partition.c output.c stats.c progress.c input.c parallel.c -pthread -lz -llzma
  * 
  */
 
@@ -20,94 +20,161 @@
 #include <getopt.h>
 #include <string.h>
 
+#include "output.h"
+#include "stats.h"
+#include "progress.h"
+#include "input.h"
+#include "parallel.h"
+
 
 #ifndef MAXN
-#define MAXN 200            /* the maximum number of vertices */
+#define MAXN 256            /* the initial maximum number of vertices */
 #endif
-#define MAXE (6*MAXN-12)    /* the maximum number of oriented edges */
-#define MAXF (2*MAXN-4)      /* the maximum number of faces */
-#define MAXVAL (MAXN-1)  /* the maximum degree of a vertex */
-#define MAXCODELENGTH (MAXN+MAXE+3)
+#define EDGECOUNT(n) (6*(n)-12)    /* the maximum number of oriented edges */
+#define FACECOUNT(n) (2*(n)-4)      /* the maximum number of faces */
+#define MAXVAL (maxn-1)  /* the maximum degree of a vertex */
+#define CODELENGTH(n) ((n)+EDGECOUNT(n)+3)
 
 #define FALSE 0
 #define TRUE  1
 
-typedef struct e /* The data type used for edges */ {
-    int start; /* vertex where the edge starts */
-    int end; /* vertex where the edge ends */
-    int rightface; /* face on the right side of the edge
-                          note: only valid if make_dual() called */
-    struct e *prev; /* previous edge in clockwise direction */
-    struct e *next; /* next edge in clockwise direction */
-    struct e *inverse; /* the edge that is inverse to this one */
-    int mark, index; /* two ints for temporary use;
-                          Only access mark via the MARK macros. */
+/* The rotation system is stored as a structure of arrays: an edge is an index
+ * into the arrays below. Tracing a face only touches edgeInverse, edgePrev,
+ * edgeRightface and edgeMark, which stay in the L1 cache for the usual graph
+ * sizes. The indices are 32-bit because the storage grows with the graphs
+ * and the 16-bit planar code allows more than 65535 edges.
+ */
+typedef int EDGE;
+
+/* The storage for the graphs is sized at runtime. The static arrays are used
+ * as long as the graphs have at most MAXN vertices. Once a larger graph is read
+ * (or a larger size is requested with --max-n) the storage moves to the heap,
+ * where it is reused for all later graphs. Each thread has its own storage,
+ * which is attached on the first call to ensureCapacity.
+ */
+__thread int maxn = MAXN; /* the number of vertices for which storage is available */
 
-} EDGE;
+__thread EDGE firstedgeStorage[MAXN];
+__thread int degreeStorage[MAXN];
+__thread EDGE facestartStorage[FACECOUNT(MAXN)];
+__thread int faceSizeStorage[FACECOUNT(MAXN)];
+__thread int edgeEndStorage[EDGECOUNT(MAXN)];
+__thread EDGE edgePrevStorage[EDGECOUNT(MAXN)];
+__thread EDGE edgeNextStorage[EDGECOUNT(MAXN)];
+__thread EDGE edgeInverseStorage[EDGECOUNT(MAXN)];
+__thread int edgeRightfaceStorage[EDGECOUNT(MAXN)];
+__thread int edgeMarkStorage[EDGECOUNT(MAXN)];
 
-EDGE *firstedge[MAXN]; /* pointer to arbitrary edge out of vertex i. */
-int degree[MAXN];
+__thread EDGE *firstedge = NULL; /* arbitrary edge out of vertex i. */
+__thread int *degree = NULL;
 
-EDGE *facestart[MAXF]; /* pointer to arbitrary edge of face i. */
-int faceSize[MAXF]; /* pointer to arbitrary edge of face i. */
+__thread EDGE *facestart = NULL; /* arbitrary edge of face i. */
+__thread int *faceSize = NULL; /* the size of face i. */
 
-EDGE edges[MAXE];
+__thread int *edgeEnd = NULL; /* vertex where the edge ends */
+__thread EDGE *edgePrev = NULL; /* previous edge in clockwise direction */
+__thread EDGE *edgeNext = NULL; /* next edge in clockwise direction */
+__thread EDGE *edgeInverse = NULL; /* the edge that is inverse to this one */
+__thread int *edgeRightface = NULL; /* face on the right side of the edge
+                                       note: only valid if makeDual() called */
+__thread int *edgeMark = NULL; /* only access the marks via the MARK macros */
 
-static int markvalue = 30000;
+static __thread int markvalue = 30000;
 #define RESETMARKS {int mki; if ((markvalue += 2) > 30000) \
-       { markvalue = 2; for (mki=0;mki<MAXE;++mki) edges[mki].mark=0;}}
-#define MARK(e) (e)->mark = markvalue
-#define MARKLO(e) (e)->mark = markvalue
-#define MARKHI(e) (e)->mark = markvalue+1
-#define UNMARK(e) (e)->mark = markvalue-1
-#define ISMARKED(e) ((e)->mark >= markvalue)
-#define ISMARKEDLO(e) ((e)->mark == markvalue)
-#define ISMARKEDHI(e) ((e)->mark > markvalue)
+       { markvalue = 2; for (mki=0;mki<EDGECOUNT(maxn);++mki) edgeMark[mki]=0;}}
+#define MARK(e) edgeMark[e] = markvalue
+#define MARKLO(e) edgeMark[e] = markvalue
+#define MARKHI(e) edgeMark[e] = markvalue+1
+#define UNMARK(e) edgeMark[e] = markvalue-1
+#define ISMARKED(e) (edgeMark[e] >= markvalue)
+#define ISMARKEDLO(e) (edgeMark[e] == markvalue)
+#define ISMARKEDHI(e) (edgeMark[e] > markvalue)
 
 int numberOfGraphs = 0;
 
-int nv;
-int ne;
-int nf;
+int writeOriginals = FALSE; /* write the original graph after each pentagon partition */
+
+__thread int nv;
+__thread int ne;
+__thread int nf;
 
 
 //////////////////////////////////////////////////////////////////////////////
 
 //=============== Writing planarcode of dual graph ===========================
 
-int faces2Pentagons[MAXF];
-int pentagonCount;
+__thread int faces2PentagonsStorage[FACECOUNT(MAXN)];
+__thread int *faces2Pentagons = NULL;
+__thread int pentagonCount;
 
-void writePentagonPartitionPlanarCodeChar(){
-    int i;
-    EDGE *e, *elast;
+/* The code of the pentagon partition is built in this buffer and then written
+ * as a whole. Each pentagon has at most 5 neighbours, so a code takes at most
+ * 1 + 6 values per face plus a leading zero byte in the 16-bit version.
+ */
+#define PENTAGONCODELENGTH(n) (1 + 2*(1 + 6*FACECOUNT(n)))
+__thread unsigned char pentagonCodeStorage[PENTAGONCODELENGTH(MAXN)];
+__thread unsigned char *pentagonCode = NULL;
+
+int buildPentagonPartitionPlanarCodeChar(){
+    int i, position = 0;
+    EDGE e, elast;
     
     //write the number of pentagons
-    fputc(pentagonCount, stdout);
+    pentagonCode[position++] = pentagonCount;
     
     for(i=0; i<nf; i++){
         if(faceSize[i]==5){
             e = elast = facestart[i];
             do {
-                if(faceSize[e->inverse->rightface]==5){
-                    fputc(faces2Pentagons[e->inverse->rightface] + 1, stdout);
+                if(faceSize[edgeRightface[edgeInverse[e]]]==5){
+                    pentagonCode[position++] = faces2Pentagons[edgeRightface[edgeInverse[e]]] + 1;
                 }
-                e = e->inverse->prev;
+                e = edgePrev[edgeInverse[e]];
             } while (e != elast);
-            fputc(0, stdout);
+            pentagonCode[position++] = 0;
         }
     }
+    
+    return position;
 }
 
-void writePentagonPartitionPlanarCode(){
-    static int first = TRUE;
+/* Stores a 16-bit value in little endian byte order. */
+#define STORESHORT(code, position, value) {\
+    (code)[(position)++] = (value) & 0xFF;\
+    (code)[(position)++] = (value) >> 8;\
+}
+
+int buildPentagonPartitionPlanarCodeShort(){
+    int i, position = 0;
+    EDGE e, elast;
+    
+    //a zero byte signals that 16-bit values follow
+    pentagonCode[position++] = 0;
     
-    if(first){
-        first = FALSE;
-        
-        fprintf(stdout, ">>planar_code<<");
+    //write the number of pentagons
+    STORESHORT(pentagonCode, position, pentagonCount);
+    
+    for(i=0; i<nf; i++){
+        if(faceSize[i]==5){
+            e = elast = facestart[i];
+            do {
+                if(faceSize[edgeRightface[edgeInverse[e]]]==5){
+                    STORESHORT(pentagonCode, position, faces2Pentagons[edgeRightface[edgeInverse[e]]] + 1);
+                }
+                e = edgePrev[edgeInverse[e]];
+            } while (e != elast);
+            STORESHORT(pentagonCode, position, 0);
+        }
     }
     
+    return position;
+}
+
+void writePlanarCodeHeader(){
+    writeString(">>planar_code<<");
+}
+
+void writePentagonPartitionPlanarCode(){
     //find labels for pentagons
     int i;
     pentagonCount=0;
@@ -119,38 +186,282 @@ void writePentagonPartitionPlanarCode(){
     }
     
     if (pentagonCount + 1 <= 255) {
-        writePentagonPartitionPlanarCodeChar();
+        writeBytes(pentagonCode, buildPentagonPartitionPlanarCodeChar());
     } else {
-        fprintf(stderr, "Graphs of that size are currently not supported -- exiting!\n");
-        exit(-1);
+        writeBytes(pentagonCode, buildPentagonPartitionPlanarCodeShort());
     }
     
 }
 
+//=============== Distances between pentagons ===========================
+
+/* The distances between the pentagons in the dual, i.e., the number of steps
+ * from face to adjacent face, are computed by a breadth-first search from all
+ * pentagons at once. Each face has a set of pentagons (one bit per pentagon)
+ * that reached it, and one round over all edges extends all searches by one
+ * step. Adjacent pentagons have distance 1. If a round reaches no new faces,
+ * the dual is not connected and the remaining pairs get the distance
+ * UNREACHABLE, which is written as "-".
+ */
+#define MAXDISTANCEPENTAGONS 64 /* the number of bits in a PENTAGONSET */
+#define DISTANCEHISTOGRAMSIZE 256 /* larger distances are counted in the last bucket */
+#define UNREACHABLE -1
+
+typedef unsigned long long PENTAGONSET;
+
+__thread PENTAGONSET reachedStorage[FACECOUNT(MAXN)];
+__thread PENTAGONSET frontierStorage[FACECOUNT(MAXN)];
+__thread PENTAGONSET nextFrontierStorage[FACECOUNT(MAXN)];
+__thread PENTAGONSET *reached = NULL; /* the pentagons that reached face i */
+__thread PENTAGONSET *frontier = NULL; /* the pentagons that reached face i in the last round */
+__thread PENTAGONSET *nextFrontier = NULL;
+
+__thread int pentagonFaces[MAXDISTANCEPENTAGONS]; /* the face of pentagon i */
+__thread int pentagonDistance[MAXDISTANCEPENTAGONS][MAXDISTANCEPENTAGONS];
+
+int computeDistances = FALSE;
+FILE *distanceFile = NULL; /* the file for the distance matrices, if any */
+FILE *distanceHistogramFile = NULL; /* the file for the histogram, if any */
+
+__thread unsigned long long distanceCounts[DISTANCEHISTOGRAMSIZE];
+unsigned long long distanceTotals[DISTANCEHISTOGRAMSIZE];
+__thread unsigned long long unreachableCount; /* the pairs in different components */
+unsigned long long unreachableTotal;
+
+/* Computes the distances between all pairs of pentagons of the current graph.
+ * writePentagonPartitionPlanarCode must be called first to label the pentagons.
+ */
+void computePentagonDistances(){
+    int i, f, distance;
+    PENTAGONSET growing;
+
+    if(pentagonCount > MAXDISTANCEPENTAGONS){
+        fprintf(stderr, "Distances can only be computed for graphs with at most %d pentagons -- exiting!\n",
+                MAXDISTANCEPENTAGONS);
+        exit(1);
+    }
+
+    for(f = 0; f < nf; f++){
+        if(faceSize[f] == 5){
+            pentagonFaces[faces2Pentagons[f]] = f;
+            reached[f] = frontier[f] = 1ULL << faces2Pentagons[f];
+            pentagonDistance[faces2Pentagons[f]][faces2Pentagons[f]] = 0;
+        } else {
+            reached[f] = frontier[f] = 0;
+        }
+    }
+    for(i = 0; i < pentagonCount; i++){
+        for(f = 0; f < pentagonCount; f++){
+            if(f != i){
+                pentagonDistance[i][f] = UNREACHABLE;
+            }
+        }
+    }
+
+    //the number of ordered pairs of pentagons whose distance is still unknown
+    int unknown = pentagonCount * (pentagonCount - 1);
+    for(distance = 1; unknown; distance++){
+        for(f = 0; f < nf; f++){
+            nextFrontier[f] = 0;
+        }
+        for(i = 0; i < ne; i++){
+            nextFrontier[edgeRightface[i]] |= frontier[edgeRightface[edgeInverse[i]]];
+        }
+        growing = 0;
+        for(f = 0; f < nf; f++){
+            frontier[f] = nextFrontier[f] & ~reached[f];
+            reached[f] |= frontier[f];
+            growing |= frontier[f];
+        }
+        if(!growing){
+            break;
+        }
+        for(i = 0; i < pentagonCount; i++){
+            PENTAGONSET found = frontier[pentagonFaces[i]];
+            while(found){
+                pentagonDistance[__builtin_ctzll(found)][i] = distance;
+                found &= found - 1;
+                unknown--;
+            }
+        }
+    }
+
+    for(i = 0; i < pentagonCount; i++){
+        for(f = i + 1; f < pentagonCount; f++){
+            distance = pentagonDistance[i][f];
+            if(distance == UNREACHABLE){
+                unreachableCount++;
+            } else {
+                distanceCounts[distance < DISTANCEHISTOGRAMSIZE ? distance : DISTANCEHISTOGRAMSIZE - 1]++;
+            }
+        }
+    }
+}
+
+/* Writes a line with the rank of the graph followed by the distances between
+ * the pentagons i and j for i < j, ordered by i and then by j.
+ */
+void writePentagonDistances(int rank){
+    static char *line = NULL;
+    static size_t lineCapacity = 0;
+    int i, j;
+
+    //at most 10 digits and a space per number
+    size_t needed = 11*(1 + pentagonCount*pentagonCount/2) + 1;
+    if(needed > lineCapacity){
+        free(line);
+        lineCapacity = needed;
+        line = malloc(lineCapacity);
+        if(line == NULL){
+            fprintf(stderr, "Insufficient memory for the distances -- exiting!\n");
+            exit(1);
+        }
+    }
+    char *position = line + sprintf(line, "%d", rank);
+    for(i = 0; i < pentagonCount; i++){
+        for(j = i + 1; j < pentagonCount; j++){
+            char digits[10];
+            int value = pentagonDistance[i][j], length = 0;
+            *position++ = ' ';
+            if(value == UNREACHABLE){
+                *position++ = '-';
+                continue;
+            }
+            do {
+                digits[length++] = '0' + value % 10;
+                value /= 10;
+            } while(value);
+            while(length){
+                *position++ = digits[--length];
+            }
+        }
+    }
+    *position++ = '\n';
+    fwrite(line, 1, position - line, distanceFile);
+}
+
+/* Adds the distances counted on this thread to the totals. */
+void addDistanceCounts(){
+    int i;
+    for(i = 0; i < DISTANCEHISTOGRAMSIZE; i++){
+        distanceTotals[i] += distanceCounts[i];
+    }
+    unreachableTotal += unreachableCount;
+}
+
+void writeDistanceHistogram(){
+    int i;
+    fprintf(distanceHistogramFile, "# distance pairs_of_pentagons\n");
+    for(i = 1; i < DISTANCEHISTOGRAMSIZE; i++){
+        if(distanceTotals[i]){
+            fprintf(distanceHistogramFile, "%d%s %llu\n", i,
+                    i == DISTANCEHISTOGRAMSIZE - 1 ? "+" : "", distanceTotals[i]);
+        }
+    }
+    if(unreachableTotal){
+        fprintf(distanceHistogramFile, "- %llu\n", unreachableTotal);
+    }
+}
+
+//=============== Graph storage ===========================
+
+/* Returns storage for count elements of the given size to replace current.
+ * The contents are not preserved. The initial storage is the static array,
+ * which is never freed.
+ */
+void *resizeStorage(void *current, void *initial, size_t count, size_t size){
+    if(current != initial){
+        free(current);
+    }
+    void *storage = malloc(count * size);
+    if(storage == NULL){
+        fprintf(stderr, "Insufficient memory for the graph storage -- exiting!\n");
+        exit(1);
+    }
+    return storage;
+}
+
+/* Makes sure that graphs with n vertices fit in the graph storage. The storage
+ * grows by at least half of its size to avoid repeated resizing when the
+ * graphs grow gradually.
+ */
+void ensureCapacity(int n){
+    if(firstedge == NULL){
+        //each thread starts with its own static storage
+        firstedge = firstedgeStorage;
+        degree = degreeStorage;
+        facestart = facestartStorage;
+        faceSize = faceSizeStorage;
+        edgeEnd = edgeEndStorage;
+        edgePrev = edgePrevStorage;
+        edgeNext = edgeNextStorage;
+        edgeInverse = edgeInverseStorage;
+        edgeRightface = edgeRightfaceStorage;
+        edgeMark = edgeMarkStorage;
+        faces2Pentagons = faces2PentagonsStorage;
+        pentagonCode = pentagonCodeStorage;
+        reached = reachedStorage;
+        frontier = frontierStorage;
+        nextFrontier = nextFrontierStorage;
+    }
+    if(n <= maxn) return;
+    if(n < maxn + maxn/2){
+        n = maxn + maxn/2;
+    }
+    firstedge = resizeStorage(firstedge, firstedgeStorage, n, sizeof(EDGE));
+    degree = resizeStorage(degree, degreeStorage, n, sizeof(int));
+    edgeEnd = resizeStorage(edgeEnd, edgeEndStorage, EDGECOUNT(n), sizeof(int));
+    edgePrev = resizeStorage(edgePrev, edgePrevStorage, EDGECOUNT(n), sizeof(EDGE));
+    edgeNext = resizeStorage(edgeNext, edgeNextStorage, EDGECOUNT(n), sizeof(EDGE));
+    edgeInverse = resizeStorage(edgeInverse, edgeInverseStorage, EDGECOUNT(n), sizeof(EDGE));
+    edgeRightface = resizeStorage(edgeRightface, edgeRightfaceStorage, EDGECOUNT(n), sizeof(int));
+    edgeMark = resizeStorage(edgeMark, edgeMarkStorage, EDGECOUNT(n), sizeof(int));
+    facestart = resizeStorage(facestart, facestartStorage, FACECOUNT(n), sizeof(EDGE));
+    faceSize = resizeStorage(faceSize, faceSizeStorage, FACECOUNT(n), sizeof(int));
+    faces2Pentagons = resizeStorage(faces2Pentagons, faces2PentagonsStorage, FACECOUNT(n), sizeof(int));
+    pentagonCode = resizeStorage(pentagonCode, pentagonCodeStorage, PENTAGONCODELENGTH(n), 1);
+    reached = resizeStorage(reached, reachedStorage, FACECOUNT(n), sizeof(PENTAGONSET));
+    frontier = resizeStorage(frontier, frontierStorage, FACECOUNT(n), sizeof(PENTAGONSET));
+    nextFrontier = resizeStorage(nextFrontier, nextFrontierStorage, FACECOUNT(n), sizeof(PENTAGONSET));
+    //force a reset of all marks on the next call to RESETMARKS
+    markvalue = 30000;
+    maxn = n;
+}
+
+void growCodeBuffer(unsigned short **code, int *capacity, int newCapacity){
+    unsigned short *buffer = realloc(*code, newCapacity * sizeof(unsigned short));
+    if(buffer == NULL){
+        fprintf(stderr, "Insufficient memory for a code of length %d -- exiting!\n", newCapacity);
+        exit(1);
+    }
+    *code = buffer;
+    *capacity = newCapacity;
+}
+
 //=============== Reading and decoding planarcode ===========================
 
-EDGE *findEdge(int from, int to) {
-    EDGE *e, *elast;
+EDGE findEdge(int from, int to) {
+    EDGE e, elast;
 
     e = elast = firstedge[from];
     do {
-        if (e->end == to) {
+        if (edgeEnd[e] == to) {
             return e;
         }
-        e = e->next;
+        e = edgeNext[e];
     } while (e != elast);
     fprintf(stderr, "error while looking for edge from %d to %d.\n", from, to);
     exit(0);
 }
 
-/* Store in the rightface field of each edge the number of the face on
+/* Store in edgeRightface for each edge the number of the face on
    the right hand side of that edge.  Faces are numbered 0,1,....  Also
    store in facestart[i] an example of an edge in the clockwise orientation
    of the face boundary, and the size of the face in facesize[i], for each i.
    Returns the number of faces. */
 void makeDual() {
     register int i, sz;
-    register EDGE *e, *ex, *ef, *efx;
+    register EDGE e, ex, ef, efx;
 
     RESETMARKS;
 
@@ -163,15 +474,15 @@ void makeDual() {
                 facestart[nf] = ef = efx = e;
                 sz = 0;
                 do {
-                    ef->rightface = nf;
+                    edgeRightface[ef] = nf;
                     MARKLO(ef);
-                    ef = ef->inverse->prev;
+                    ef = edgePrev[edgeInverse[ef]];
                     ++sz;
                 } while (ef != efx);
                 faceSize[nf] = sz;
                 ++nf;
             }
-            e = e->next;
+            e = edgeNext[e];
         } while (e != ex);
     }
 }
@@ -181,23 +492,22 @@ void decodePlanarCode(unsigned short* code) {
      */
     int i, j, codePosition;
     int edgeCounter = 0;
-    EDGE *inverse;
+    EDGE inverse;
 
     nv = code[0];
     codePosition = 1;
 
+    ensureCapacity(nv);
+
     for (i = 0; i < nv; i++) {
         degree[i] = 0;
-        firstedge[i] = edges + edgeCounter;
-        edges[edgeCounter].start = i;
-        edges[edgeCounter].end = code[codePosition] - 1;
-        edges[edgeCounter].next = edges + edgeCounter + 1;
+        firstedge[i] = edgeCounter;
+        edgeEnd[edgeCounter] = code[codePosition] - 1;
+        edgeNext[edgeCounter] = edgeCounter + 1;
         if (code[codePosition] - 1 < i) {
             inverse = findEdge(code[codePosition] - 1, i);
-            edges[edgeCounter].inverse = inverse;
-            inverse->inverse = edges + edgeCounter;
-        } else {
-            edges[edgeCounter].inverse = NULL;
+            edgeInverse[edgeCounter] = inverse;
+            edgeInverse[inverse] = edgeCounter;
         }
         edgeCounter++;
         codePosition++;
@@ -206,47 +516,67 @@ void decodePlanarCode(unsigned short* code) {
                 fprintf(stderr, "MAXVAL too small: %d\n", MAXVAL);
                 exit(0);
             }
-            edges[edgeCounter].start = i;
-            edges[edgeCounter].end = code[codePosition] - 1;
-            edges[edgeCounter].prev = edges + edgeCounter - 1;
-            edges[edgeCounter].next = edges + edgeCounter + 1;
+            edgeEnd[edgeCounter] = code[codePosition] - 1;
+            edgePrev[edgeCounter] = edgeCounter - 1;
+            edgeNext[edgeCounter] = edgeCounter + 1;
             if (code[codePosition] - 1 < i) {
                 inverse = findEdge(code[codePosition] - 1, i);
-                edges[edgeCounter].inverse = inverse;
-                inverse->inverse = edges + edgeCounter;
-            } else {
-                edges[edgeCounter].inverse = NULL;
+                edgeInverse[edgeCounter] = inverse;
+                edgeInverse[inverse] = edgeCounter;
             }
             edgeCounter++;
         }
-        firstedge[i]->prev = edges + edgeCounter - 1;
-        edges[edgeCounter - 1].next = firstedge[i];
+        edgePrev[firstedge[i]] = edgeCounter - 1;
+        edgeNext[edgeCounter - 1] = firstedge[i];
         degree[i] = j;
 
         codePosition++; /* read the closing 0 */
     }
 
     ne = edgeCounter;
+    markStage(STAGE_DECODE);
 
     makeDual();
+    markStage(STAGE_DUAL);
 
     // nv - ne/2 + nf = 2
 }
 
+/* Returns the next byte of a code or header. Exits if the input ends there,
+ * instead of storing EOF in the code and reading on forever.
+ */
+static inline unsigned short readCodeByte(FILE *file){
+    int c = getc(file);
+    if (c == EOF) {
+        fprintf(stderr, "The input ends in the middle of a graph -- exiting!\n");
+        exit(1);
+    }
+    return c;
+}
+
 /**
- * 
- * @param code
+ * Reads the next code into *codePointer. The buffer is (re)allocated when
+ * it is too small for the code and *codeCapacity is updated accordingly.
+ *
+ * @param codePointer
+ * @param codeCapacity
  * @param length
  * @param file
  * @return returns 1 if a code was read and 0 otherwise. Exits in case of error.
  */
-int readPlanarCode(unsigned short code[], int *length, FILE *file) {
+int readPlanarCode(unsigned short **codePointer, int *codeCapacity, int *length, FILE *file) {
     static int first = 1;
     unsigned char c;
     char testheader[20];
     int bufferSize, zeroCounter;
     
     int readCount;
+    unsigned short *code;
+
+    if (*codeCapacity < CODELENGTH(maxn)) {
+        growCodeBuffer(codePointer, codeCapacity, CODELENGTH(maxn));
+    }
+    code = *codePointer;
 
 
     if (first) {
@@ -289,16 +619,16 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
         code[0] = c;
         bufferSize = 1;
         zeroCounter = 0;
-        code[1] = (unsigned short) getc(file);
+        code[1] = readCodeByte(file);
         if (code[1] == 0) zeroCounter++;
-        code[2] = (unsigned short) getc(file);
+        code[2] = readCodeByte(file);
         if (code[2] == 0) zeroCounter++;
         bufferSize = 3;
         // 3 characters were read and stored in buffer
         if ((code[1] == '>') && (code[2] == 'p')) /*we are sure that we're dealing with a header*/ {
-            while ((c = getc(file)) != '<');
+            while ((c = readCodeByte(file)) != '<');
             /* read 2 more characters: */
-            c = getc(file);
+            c = readCodeByte(file);
             if (c != '<') {
                 fprintf(stderr, "Problems with header -- single '<'\n");
                 exit(1);
@@ -318,12 +648,16 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
 
     if (c != 0) /* unsigned chars would be sufficient */ {
         code[0] = c;
-        if (code[0] > MAXN) {
-            fprintf(stderr, "Constant N too small %d > %d \n", code[0], MAXN);
-            exit(1);
+        if (*codeCapacity < CODELENGTH(code[0])) {
+            growCodeBuffer(codePointer, codeCapacity, CODELENGTH(code[0]));
+            code = *codePointer;
         }
         while (zeroCounter < code[0]) {
-            code[bufferSize] = (unsigned short) getc(file);
+            if (bufferSize == *codeCapacity) {
+                growCodeBuffer(codePointer, codeCapacity, 2 * *codeCapacity);
+                code = *codePointer;
+            }
+            code[bufferSize] = readCodeByte(file);
             if (code[bufferSize] == 0) zeroCounter++;
             bufferSize++;
         }
@@ -333,13 +667,17 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
             fprintf(stderr, "Unexpected EOF.\n");
             exit(1);
         }
-        if (code[0] > MAXN) {
-            fprintf(stderr, "Constant N too small %d > %d \n", code[0], MAXN);
-            exit(1);
+        if (*codeCapacity < CODELENGTH(code[0])) {
+            growCodeBuffer(codePointer, codeCapacity, CODELENGTH(code[0]));
+            code = *codePointer;
         }
         bufferSize = 1;
         zeroCounter = 0;
         while (zeroCounter < code[0]) {
+            if (bufferSize == *codeCapacity) {
+                growCodeBuffer(codePointer, codeCapacity, 2 * *codeCapacity);
+                code = *codePointer;
+            }
             readCount = fread(code + bufferSize, sizeof (unsigned short), 1, file);
             if(!readCount){
                 fprintf(stderr, "Unexpected EOF.\n");
@@ -356,21 +694,306 @@ int readPlanarCode(unsigned short code[], int *length, FILE *file) {
 
 }
 
+//=============== Reading and winding up face spirals ===========================
+
+/* A face spiral of a fullerene is given by the positions of its 12 pentagons
+ * in the spiral. The pentagon partition is built by winding up the spiral:
+ * the faces are added one by one to a patch and each new face is adjacent to
+ * the previous face and to the first face of the patch that is still open.
+ * The cubic graph itself is never built. For the hexagons only the number of
+ * neighbours is kept; for the pentagons also the neighbours in cyclic order.
+ */
+
+#define PENTAGONS 12
+#define SPIRALLENGTH (PENTAGONS + 1) /* the number of vertices and the positions */
+
+int spiralCapacity = 0; /* the number of faces for which storage is available */
+int *neighbourCount = NULL; /* the number of neighbours of face i found so far */
+int *pentagonLabel = NULL; /* the label of face i if it is a pentagon and -1 otherwise */
+int *boundary = NULL; /* the open faces of the patch */
+
+/* The neighbours of pentagon i are pentagonNeighbours[i][firstNeighbour[i]]
+ * up to pentagonNeighbours[i][lastNeighbour[i]-1] in cyclic order. New
+ * neighbours are added at either end, so the list starts in the middle.
+ */
+int pentagonNeighbours[PENTAGONS][10];
+int firstNeighbour[PENTAGONS];
+int lastNeighbour[PENTAGONS];
+
+void ensureSpiralCapacity(int faceCount){
+    if(faceCount <= spiralCapacity) return;
+    free(neighbourCount);
+    free(pentagonLabel);
+    free(boundary);
+    neighbourCount = malloc(faceCount * sizeof(int));
+    pentagonLabel = malloc(faceCount * sizeof(int));
+    boundary = malloc(faceCount * sizeof(int));
+    if(neighbourCount == NULL || pentagonLabel == NULL || boundary == NULL){
+        fprintf(stderr, "Insufficient memory for a spiral with %d faces -- exiting!\n", faceCount);
+        exit(1);
+    }
+    spiralCapacity = faceCount;
+}
+
+void invalidSpiral(){
+    fprintf(stderr, "Spiral %d does not describe a fullerene -- exiting!\n", numberOfGraphs + 1);
+    exit(1);
+}
+
+/* Makes the new face adjacent to the given face of the patch. The new face is
+ * attached to the front of the boundary after the neighbours of that face,
+ * and to the back of the boundary before them. Seen from the new face it is
+ * the other way around.
+ */
+void connectFaces(int newFace, int face, int atFront){
+    int label;
+
+    if(neighbourCount[face] == (pentagonLabel[face] < 0 ? 6 : 5) ||
+            neighbourCount[newFace] == (pentagonLabel[newFace] < 0 ? 6 : 5)){
+        invalidSpiral();
+    }
+    neighbourCount[face]++;
+    neighbourCount[newFace]++;
+
+    label = pentagonLabel[face];
+    if(label >= 0){
+        if(atFront){
+            pentagonNeighbours[label][lastNeighbour[label]++] = newFace;
+        } else {
+            pentagonNeighbours[label][--firstNeighbour[label]] = newFace;
+        }
+    }
+    label = pentagonLabel[newFace];
+    if(label >= 0){
+        if(atFront){
+            pentagonNeighbours[label][--firstNeighbour[label]] = face;
+        } else {
+            pentagonNeighbours[label][lastNeighbour[label]++] = face;
+        }
+    }
+}
+
+#define FACECLOSED(f) (neighbourCount[f] == (pentagonLabel[f] < 0 ? 6 : 5))
+
+/* Winds up the spiral of a fullerene with the given number of vertices. Exits
+ * if the spiral does not describe a fullerene.
+ */
+void windUpSpiral(int vertexCount, int *pentagons){
+    int faceCount = vertexCount/2 + 2;
+    int i, face, front, back;
+
+    ensureSpiralCapacity(faceCount);
+    for(i = 0; i < faceCount; i++){
+        neighbourCount[i] = 0;
+        pentagonLabel[i] = -1;
+    }
+    for(i = 0; i < PENTAGONS; i++){
+        pentagonLabel[pentagons[i] - 1] = i;
+        firstNeighbour[i] = lastNeighbour[i] = 5;
+    }
+
+    //the boundary of the patch runs from boundary[front] to boundary[back]
+    front = back = 0;
+    boundary[0] = 0;
+    connectFaces(1, 0, FALSE);
+    boundary[++back] = 1;
+    for(face = 2; face < faceCount - 1; face++){
+        connectFaces(face, boundary[back], FALSE);
+        connectFaces(face, boundary[front], TRUE);
+        while(TRUE){
+            if(FACECLOSED(boundary[front])){
+                front++;
+                if(front >= back) invalidSpiral();
+                connectFaces(face, boundary[front], TRUE);
+            } else if(FACECLOSED(boundary[back])){
+                back--;
+                if(front >= back) invalidSpiral();
+                connectFaces(face, boundary[back], FALSE);
+            } else {
+                break;
+            }
+        }
+        if(FACECLOSED(face)) invalidSpiral();
+        boundary[++back] = face;
+    }
+
+    //the last face closes the patch
+    for(i = front; i <= back; i++){
+        connectFaces(faceCount - 1, boundary[i], TRUE);
+    }
+    for(i = front; i <= back; i++){
+        if(!FACECLOSED(boundary[i])) invalidSpiral();
+    }
+    if(!FACECLOSED(faceCount - 1)) invalidSpiral();
+}
+
+void writeSpiralPentagonPartitionPlanarCode(){
+    unsigned char code[1 + 6*PENTAGONS];
+    int i, j, position = 0;
+
+    code[position++] = PENTAGONS;
+    for(i = 0; i < PENTAGONS; i++){
+        for(j = firstNeighbour[i]; j < lastNeighbour[i]; j++){
+            if(pentagonLabel[pentagonNeighbours[i][j]] >= 0){
+                code[position++] = pentagonLabel[pentagonNeighbours[i][j]] + 1;
+            }
+        }
+        code[position++] = 0;
+    }
+    writeBytes(code, position);
+}
+
+/**
+ * Reads the next spiral. A spiral is a line with the number of vertices
+ * followed by the positions (starting from 1) of the pentagons in increasing
+ * order. All characters other than digits separate the numbers, so e.g.
+ * "C60: 1,7,9,..." is also accepted. Empty lines are skipped.
+ *
+ * @return returns 1 if a spiral was read and 0 otherwise. Exits in case of error.
+ */
+int readSpiral(int *vertexCount, int *pentagons, FILE *file){
+    int numbers[SPIRALLENGTH];
+    int c, i, count = 0, value = 0, inNumber = FALSE;
+
+    while((c = getc(file)) != EOF){
+        if(c >= '0' && c <= '9'){
+            if(value > 1000000){
+                fprintf(stderr, "Number too large in spiral %d -- exiting!\n", numberOfGraphs + 1);
+                exit(1);
+            }
+            value = 10*value + c - '0';
+            inNumber = TRUE;
+        } else {
+            if(inNumber){
+                if(count < SPIRALLENGTH) numbers[count] = value;
+                count++;
+                value = 0;
+                inNumber = FALSE;
+            }
+            if(c == '\n' && count) break;
+        }
+    }
+    if(inNumber){
+        if(count < SPIRALLENGTH) numbers[count] = value;
+        count++;
+    }
+    if(count == 0){
+        return FALSE;
+    }
+    if(count != SPIRALLENGTH){
+        fprintf(stderr, "Spiral %d does not consist of the number of vertices and %d pentagons -- exiting!\n",
+                numberOfGraphs + 1, PENTAGONS);
+        exit(1);
+    }
+
+    *vertexCount = numbers[0];
+    if(*vertexCount < 20 || *vertexCount % 2){
+        fprintf(stderr, "Spiral %d does not describe a fullerene -- exiting!\n", numberOfGraphs + 1);
+        exit(1);
+    }
+    for(i = 0; i < PENTAGONS; i++){
+        pentagons[i] = numbers[i + 1];
+        if(pentagons[i] < 1 || pentagons[i] > *vertexCount/2 + 2 ||
+                (i && pentagons[i] <= pentagons[i - 1])){
+            fprintf(stderr, "Spiral %d has illegal pentagon positions -- exiting!\n", numberOfGraphs + 1);
+            exit(1);
+        }
+    }
+    return TRUE;
+}
+
+//=============== Parallel analysis ===========================
+
+void analyseBatch(BATCH *batch){
+    int i;
+    if(batch->sequence == 0 && unorderedPrefix == NULL){
+        writePlanarCodeHeader();
+    }
+    for(i = 0; i < batch->count; i++){
+        startGraph();
+        decodePlanarCode(batch->codes + batch->codeStart[i]);
+        writePentagonPartitionPlanarCode();
+        if(computeDistances){
+            computePentagonDistances();
+        }
+        if(writeOriginals){
+            writePlanarCode(batch->codes + batch->codeStart[i],
+                    batch->codeStart[i + 1] - batch->codeStart[i]);
+        }
+        markStage(STAGE_OUTPUT);
+    }
+}
+
+void finishWorker(int worker){
+    addDistanceCounts();
+}
+
+PARALLELANALYSIS parallelAnalysis = {NULL, analyseBatch, finishWorker};
+
 //====================== USAGE =======================
 
 void help(char *name) {
     fprintf(stderr, "The program %s writes out the pentagon partition\nfor a fullerene, nanotube cap, or a patch.\n\n", name);
     fprintf(stderr, "Usage\n=====\n");
-    fprintf(stderr, " %s [options]\n\n", name);
-    fprintf(stderr, "\nThis program can handle graphs up to %d vertices. Recompile if you need larger\n", MAXN);
-    fprintf(stderr, "graphs.\n\n");
+    fprintf(stderr, " %s [options] [file ...]\n\n", name);
+    fprintf(stderr, "\nThe graphs are read from the given files one after the other, or from\n");
+    fprintf(stderr, "standard in if no files are given.\n");
+    fprintf(stderr, "The storage for the graphs grows when larger graphs are read. Use the\n");
+    fprintf(stderr, "option --max-n to allocate it for a given number of vertices in advance.\n");
+    fprintf(stderr, "Pentagon partitions with more than 254 pentagons are written using 16-bit\n");
+    fprintf(stderr, "little endian planar code.\n\n");
     fprintf(stderr, "Valid options\n=============\n");
     fprintf(stderr, "    -h, --help\n");
     fprintf(stderr, "       Print this help and return.\n");
+    fprintf(stderr, "    -m, --max-n n\n");
+    fprintf(stderr, "       Allocate the storage for graphs with up to n vertices at the start.\n");
+    fprintf(stderr, "    --stats[=file]\n");
+    fprintf(stderr, "       Write statistics about this run (time per stage, throughput and graph\n");
+    fprintf(stderr, "       sizes) in JSON to stderr or to the given file.\n");
+    fprintf(stderr, "    --progress seconds\n");
+    fprintf(stderr, "       Report the progress every given number of seconds. A report is also\n");
+    fprintf(stderr, "       written to stderr when the program receives SIGUSR1.\n");
+    fprintf(stderr, "    --async-input\n");
+    fprintf(stderr, "       Read the input on a separate thread, so reading and processing overlap.\n");
+    fprintf(stderr, "    -t, --threads n\n");
+    fprintf(stderr, "       Analyse the graphs on n threads. The default is 1.\n");
+    fprintf(stderr, "    -u, --unordered prefix\n");
+    fprintf(stderr, "       Do not keep the order of the input: each thread writes its output to\n");
+    fprintf(stderr, "       the file prefix.i as soon as a batch of graphs is analysed, and\n");
+    fprintf(stderr, "       prefix.manifest lists these files. The output of a batch is written\n");
+    fprintf(stderr, "       as a record with the rank of its first graph, its number of graphs and\n");
+    fprintf(stderr, "       its length, followed by the pentagon partitions in\n");
+    fprintf(stderr, "       planar code without a header.\n");
+    fprintf(stderr, "    -s, --spiral\n");
+    fprintf(stderr, "       Read face spirals of fullerenes instead of planar code. Each line\n");
+    fprintf(stderr, "       contains the number of vertices followed by the positions of the 12\n");
+    fprintf(stderr, "       pentagons in the spiral (starting from 1). This option cannot be\n");
+    fprintf(stderr, "       combined with --threads.\n");
+    fprintf(stderr, "    -o, --original\n");
+    fprintf(stderr, "       Write each graph after its pentagon partition. The programs\n");
+    fprintf(stderr, "       has_six_cluster and appearances_of_clusters can then write the graphs\n");
+    fprintf(stderr, "       that match instead of their ranks with their option --original.\n");
+    fprintf(stderr, "    -z, --compress[=level]\n");
+    fprintf(stderr, "       Compress the output with gzip at the given level (1 to 9, the default\n");
+    fprintf(stderr, "       is 1). The output is split in frames of at most %d graphs that are\n", BATCHGRAPHS);
+    fprintf(stderr, "       compressed on the worker threads when combined with --threads.\n");
+    fprintf(stderr, "    --frame-table file\n");
+    fprintf(stderr, "       Write the offsets of the compressed frames to the given file.\n");
+    fprintf(stderr, "    -d, --distances file\n");
+    fprintf(stderr, "       Write the distances between the pentagons in the dual to the given file.\n");
+    fprintf(stderr, "       Each line contains the rank of a graph followed by the distances\n");
+    fprintf(stderr, "       between the pentagons i and j for i < j (ordered by i and then by j)\n");
+    fprintf(stderr, "       in the numbering of the pentagon partition. Adjacent pentagons have\n");
+    fprintf(stderr, "       distance 1, and pentagons in different components of the dual have\n");
+    fprintf(stderr, "       distance -. This option cannot be combined with --threads.\n");
+    fprintf(stderr, "    -D, --distance-histogram[=file]\n");
+    fprintf(stderr, "       Write the number of pairs of pentagons at each distance, summed over\n");
+    fprintf(stderr, "       all graphs, to stderr or to the given file. The pairs in different\n");
+    fprintf(stderr, "       components of the dual are counted on a last line starting with -.\n");
 }
 
 void usage(char *name) {
-    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "Usage: %s [options] [file ...]\n", name);
     fprintf(stderr, "For more information type: %s -h \n\n", name);
 }
 
@@ -381,15 +1004,95 @@ int main(int argc, char *argv[]) {
     int c;
     char *name = argv[0];
     static struct option long_options[] = {
-        {"help", no_argument, NULL, 'h'}
+        {"help", no_argument, NULL, 'h'},
+        {"max-n", required_argument, NULL, 'm'},
+        {"stats", optional_argument, NULL, 'S'},
+        {"progress", required_argument, NULL, 'T'},
+        {"async-input", no_argument, NULL, 'A'},
+        {"threads", required_argument, NULL, 't'},
+        {"unordered", required_argument, NULL, 'u'},
+        {"spiral", no_argument, NULL, 's'},
+        {"original", no_argument, NULL, 'o'},
+        {"compress", optional_argument, NULL, 'z'},
+        {"frame-table", required_argument, NULL, 'F'},
+        {"distances", required_argument, NULL, 'd'},
+        {"distance-histogram", optional_argument, NULL, 'D'},
+        {NULL, 0, NULL, 0}
     };
     int option_index = 0;
+    int progressInterval = 0;
+    int threadCount = 1;
+    int asyncInput = FALSE;
+    int spiralInput = FALSE;
+    int level = 0;
+    char *frameTableName = NULL;
 
-    while ((c = getopt_long(argc, argv, "h", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "hm:t:soz::d:D::u:", long_options, &option_index)) != -1) {
         switch (c) {
             case 'h':
                 help(name);
                 return EXIT_SUCCESS;
+            case 'm':
+                ensureCapacity(atoi(optarg));
+                break;
+            case 'S':
+                initStats(optarg);
+                break;
+            case 't':
+                threadCount = atoi(optarg);
+                if(threadCount < 1){
+                    fprintf(stderr, "The number of threads should be positive.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                asyncInput = TRUE;
+                break;
+            case 'u':
+                startUnorderedOutput(optarg);
+                break;
+            case 's':
+                spiralInput = TRUE;
+                break;
+            case 'o':
+                writeOriginals = TRUE;
+                break;
+            case 'z':
+                level = optarg == NULL ? 1 : atoi(optarg);
+                if(level < 1 || level > 9){
+                    fprintf(stderr, "The compression level should be between 1 and 9.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'F':
+                frameTableName = optarg;
+                break;
+            case 'd':
+                distanceFile = fopen(optarg, "w");
+                if(distanceFile == NULL){
+                    fprintf(stderr, "Could not open %s -- exiting!\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                computeDistances = TRUE;
+                break;
+            case 'D':
+                distanceHistogramFile = optarg == NULL ? stderr : fopen(optarg, "w");
+                if(distanceHistogramFile == NULL){
+                    fprintf(stderr, "Could not open %s -- exiting!\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                computeDistances = TRUE;
+                break;
+            case 'T':
+                progressInterval = atoi(optarg);
+                if(progressInterval < 1){
+                    fprintf(stderr, "The progress interval should be positive.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
             case '?':
                 usage(name);
                 return EXIT_FAILURE;
@@ -400,18 +1103,116 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    if(spiralInput && (threadCount > 1 || unorderedPrefix != NULL)){
+        fprintf(stderr, "The option --spiral cannot be combined with --threads or --unordered.\n");
+        usage(name);
+        return EXIT_FAILURE;
+    }
+    if(spiralInput && writeOriginals){
+        fprintf(stderr, "The option --spiral cannot be combined with --original.\n");
+        usage(name);
+        return EXIT_FAILURE;
+    }
+    if(spiralInput && computeDistances){
+        fprintf(stderr, "The option --spiral cannot be combined with --distances or --distance-histogram.\n");
+        usage(name);
+        return EXIT_FAILURE;
+    }
+    if(distanceFile != NULL && (threadCount > 1 || unorderedPrefix != NULL)){
+        fprintf(stderr, "The option --distances cannot be combined with --threads or --unordered.\n");
+        usage(name);
+        return EXIT_FAILURE;
+    }
+    if(level && unorderedPrefix != NULL){
+        fprintf(stderr, "The option --compress cannot be combined with --unordered.\n");
+        usage(name);
+        return EXIT_FAILURE;
+    }
+    if(frameTableName != NULL && !level){
+        fprintf(stderr, "The option --frame-table requires --compress.\n");
+        usage(name);
+        return EXIT_FAILURE;
+    }
+
     /*=========== read planar graphs ===========*/
 
-    unsigned short code[MAXCODELENGTH];
-    int length;
-    while (readPlanarCode(code, &length, stdin)) {
-        decodePlanarCode(code);
-        writePentagonPartitionPlanarCode();
-        numberOfGraphs++;
+    startProgress(&numberOfGraphs, progressInterval, NULL);
+    FILE *input = optind < argc ?
+            openInputFiles(argv + optind, argc - optind, asyncInput) : openInput(0, asyncInput);
+    if(level){
+        startCompressedOutput(level, frameTableName);
+    }
+
+    if(spiralInput){
+        int pentagons[PENTAGONS];
+        startGraph();
+        while (readSpiral(&nv, pentagons, input)) {
+            markStage(STAGE_READ);
+            windUpSpiral(nv, pentagons);
+            markStage(STAGE_DUAL);
+            recordGraph(nv, 3*nv, SPIRALLENGTH);
+            if(numberOfGraphs == 0){
+                writePlanarCodeHeader();
+            }
+            writeSpiralPentagonPartitionPlanarCode();
+            numberOfGraphs++;
+            if(level && numberOfGraphs % BATCHGRAPHS == 0){
+                endFrame(numberOfGraphs);
+            }
+            markStage(STAGE_OUTPUT);
+            startGraph();
+        }
+    } else if(threadCount > 1 || unorderedPrefix != NULL){
+        analyseInParallel(input, threadCount, &parallelAnalysis, &numberOfGraphs);
+    } else {
+        unsigned short *code = NULL;
+        int codeCapacity = 0;
+        int length;
+        startGraph();
+        while (readPlanarCode(&code, &codeCapacity, &length, input)) {
+            markStage(STAGE_READ);
+            decodePlanarCode(code);
+            recordGraph(nv, ne, length);
+            if(numberOfGraphs == 0){
+                writePlanarCodeHeader();
+            }
+            writePentagonPartitionPlanarCode();
+            if(computeDistances){
+                computePentagonDistances();
+                if(distanceFile != NULL){
+                    writePentagonDistances(numberOfGraphs + 1);
+                }
+            }
+            if(writeOriginals){
+                writePlanarCode(code, length);
+            }
+            numberOfGraphs++;
+            if(level && numberOfGraphs % BATCHGRAPHS == 0){
+                endFrame(numberOfGraphs);
+            }
+            markStage(STAGE_OUTPUT);
+            startGraph();
+        }
+    }
+    if(level){
+        finishCompressedOutput(numberOfGraphs);
+    } else {
+        flushOutput();
+    }
+    if(threadCount == 1 && unorderedPrefix == NULL){
+        addDistanceCounts();
+    }
+    if(distanceFile != NULL && fclose(distanceFile)){
+        fprintf(stderr, "Could not write the distances -- exiting!\n");
+        return EXIT_FAILURE;
+    }
+    if(distanceHistogramFile != NULL){
+        writeDistanceHistogram();
     }
     
     fprintf(stderr, "Output pentagon partition of %d graph%s.\n", numberOfGraphs, 
                 numberOfGraphs==1 ? "" : "s");
+    finishStats();
     
     return EXIT_SUCCESS;
 }
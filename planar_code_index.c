@@ -0,0 +1,428 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+/* This program gives random access to the graphs in a file in planar code.
+ * Planar code has no fixed record length, so finding the graph with a given
+ * rank normally requires reading all graphs before it. This program builds a
+ * sidecar index with the byte offset of every K-th graph. With the option
+ * --ranks it uses this index to write the graphs with the given ranks, which
+ * costs reading at most K graphs per range of ranks.
+ *
+ * The ranks start from 1, like the ranks written by has_six_cluster and
+ * appearances_of_clusters.
+ *
+ *
+ * Compile with:
+ *
+ *     cc -o planar_code_index -O4 planar_code_index.c output.c -lz
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <getopt.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "output.h"
+
+#define DEFAULTINTERVAL 1024
+#define READBUFFERSIZE (1<<20)
+
+#define INDEXMAGIC "PCINDEX1"
+
+/* The index file starts with this header, followed by the offsets of the
+ * graphs 0, K, 2K, ... (counted from 0) as 64-bit values. All values are
+ * stored in the byte order of the machine.
+ */
+typedef struct {
+    char magic[8];
+    unsigned long long interval; /* K */
+    unsigned long long graphCount;
+    unsigned long long fileSize; /* used to detect an index that is out of date */
+    long long modificationTime;
+} INDEXHEADER;
+
+//=============== Reading planar code ===========================
+
+int inputFd;
+unsigned char readBuffer[READBUFFERSIZE];
+int readPosition = 0;
+int readLength = 0;
+unsigned long long bufferOffset = 0; /* the offset in the file of readBuffer[0] */
+
+/* Returns the next byte of the file or EOF. */
+static inline int nextByte(){
+    if(readPosition == readLength){
+        bufferOffset += readLength;
+        readLength = read(inputFd, readBuffer, READBUFFERSIZE);
+        readPosition = 0;
+        if(readLength < 0){
+            perror("Could not read the graphs");
+            exit(1);
+        }
+        if(readLength == 0){
+            return EOF;
+        }
+    }
+    return readBuffer[readPosition++];
+}
+
+static inline unsigned long long currentOffset(){
+    return bufferOffset + readPosition;
+}
+
+void seekInput(unsigned long long offset){
+    if(lseek(inputFd, offset, SEEK_SET) == (off_t)-1){
+        perror("Could not seek in the graphs");
+        exit(1);
+    }
+    bufferOffset = offset;
+    readPosition = readLength = 0;
+}
+
+static inline int nextByteInCode(){
+    int c = nextByte();
+    if(c == EOF){
+        fprintf(stderr, "Unexpected EOF.\n");
+        exit(1);
+    }
+    return c;
+}
+
+/* Skips a header, of which the first character has already been read. */
+void skipHeader(){
+    int c;
+    while((c = nextByteInCode()) != '<');
+    if(nextByteInCode() != '<'){
+        fprintf(stderr, "Problems with header -- single '<'\n");
+        exit(1);
+    }
+}
+
+/* Reads the next graph. If copy is true, the bytes of the graph are written
+ * to standard out without any change. Headers before the graph are skipped,
+ * also those inside the file. Returns 1 if a graph was read and 0 otherwise.
+ */
+int skipGraph(int copy){
+    int c, n, zeroCounter = 0;
+    unsigned char start[3];
+    int startLength = 0;
+
+    while(1){
+        c = nextByte();
+        if(c == EOF){
+            return 0;
+        }
+        if(c != '>'){
+            break;
+        }
+        //could be a header, or a graph with 62 vertices
+        start[0] = c;
+        start[1] = nextByteInCode();
+        start[2] = nextByteInCode();
+        if(start[1] == '>' && start[2] == 'p'){
+            skipHeader();
+        } else {
+            startLength = 3;
+            if(start[1] == 0) zeroCounter++;
+            if(start[2] == 0) zeroCounter++;
+            break;
+        }
+    }
+
+    if(startLength){
+        n = start[0];
+        if(copy) writeBytes(start, startLength);
+    } else {
+        n = c;
+        if(copy) writeByte(c);
+    }
+
+    if(n != 0){
+        while(zeroCounter < n){
+            c = nextByteInCode();
+            if(copy) writeByte(c);
+            if(c == 0) zeroCounter++;
+        }
+    } else {
+        int low = nextByteInCode();
+        int high = nextByteInCode();
+        if(copy){
+            writeByte(low);
+            writeByte(high);
+        }
+        n = low | high << 8;
+        while(zeroCounter < n){
+            low = nextByteInCode();
+            high = nextByteInCode();
+            if(copy){
+                writeByte(low);
+                writeByte(high);
+            }
+            if(low == 0 && high == 0) zeroCounter++;
+        }
+    }
+    return 1;
+}
+
+//=============== Building and reading the index ===========================
+
+void fillIndexHeader(INDEXHEADER *header, unsigned long long interval,
+        unsigned long long graphCount){
+    struct stat status;
+    if(fstat(inputFd, &status)){
+        perror("Could not inspect the graphs");
+        exit(1);
+    }
+    memset(header, 0, sizeof(INDEXHEADER));
+    memcpy(header->magic, INDEXMAGIC, 8);
+    header->interval = interval;
+    header->graphCount = graphCount;
+    header->fileSize = status.st_size;
+    header->modificationTime = status.st_mtime;
+}
+
+void buildIndex(const char *indexName, unsigned long long interval){
+    unsigned long long *offsets = NULL;
+    unsigned long long graphCount = 0, offset;
+    size_t capacity = 0, count = 0;
+    INDEXHEADER header;
+
+    while(1){
+        offset = currentOffset();
+        if(!skipGraph(0)){
+            break;
+        }
+        if(graphCount % interval == 0){
+            if(count == capacity){
+                capacity = capacity ? 2*capacity : 1024;
+                offsets = realloc(offsets, capacity * sizeof(unsigned long long));
+                if(offsets == NULL){
+                    fprintf(stderr, "Insufficient memory for the index -- exiting!\n");
+                    exit(1);
+                }
+            }
+            offsets[count++] = offset;
+        }
+        graphCount++;
+    }
+
+    fillIndexHeader(&header, interval, graphCount);
+    FILE *f = fopen(indexName, "wb");
+    if(f == NULL){
+        fprintf(stderr, "Could not open the index %s -- exiting!\n", indexName);
+        exit(1);
+    }
+    if(fwrite(&header, sizeof(INDEXHEADER), 1, f) != 1 ||
+            fwrite(offsets, sizeof(unsigned long long), count, f) != count ||
+            fclose(f)){
+        fprintf(stderr, "Could not write the index %s -- exiting!\n", indexName);
+        exit(1);
+    }
+    free(offsets);
+
+    fprintf(stderr, "Indexed %llu graph%s.\n", graphCount, graphCount==1 ? "" : "s");
+}
+
+/* The index that is used to find the graphs. Without an index file,
+ * indexOffsets is NULL and the graphs are read from the start of the file.
+ */
+INDEXHEADER graphIndex;
+unsigned long long *indexOffsets = NULL;
+
+/* Reads the index. Returns 0 if the file does not exist. Exits if the index
+ * is invalid or out of date.
+ */
+int readIndex(const char *indexName){
+    INDEXHEADER current;
+    FILE *f = fopen(indexName, "rb");
+    if(f == NULL){
+        return 0;
+    }
+    if(fread(&graphIndex, sizeof(INDEXHEADER), 1, f) != 1 ||
+            memcmp(graphIndex.magic, INDEXMAGIC, 8) || graphIndex.interval == 0){
+        fprintf(stderr, "%s is not an index -- exiting!\n", indexName);
+        exit(1);
+    }
+    fillIndexHeader(&current, graphIndex.interval, graphIndex.graphCount);
+    if(current.fileSize != graphIndex.fileSize ||
+            current.modificationTime != graphIndex.modificationTime){
+        fprintf(stderr, "The index %s is out of date -- exiting!\n", indexName);
+        exit(1);
+    }
+    size_t count = (graphIndex.graphCount + graphIndex.interval - 1) / graphIndex.interval;
+    indexOffsets = malloc((count ? count : 1) * sizeof(unsigned long long));
+    if(indexOffsets == NULL){
+        fprintf(stderr, "Insufficient memory for the index -- exiting!\n");
+        exit(1);
+    }
+    if(fread(indexOffsets, sizeof(unsigned long long), count, f) != count){
+        fprintf(stderr, "The index %s is truncated -- exiting!\n", indexName);
+        exit(1);
+    }
+    fclose(f);
+    return 1;
+}
+
+/* Writes the graphs with ranks first up to last. */
+void writeRanks(unsigned long long first, unsigned long long last){
+    unsigned long long graph, block = (first - 1) / graphIndex.interval;
+
+    if(indexOffsets != NULL && last > graphIndex.graphCount){
+        fprintf(stderr, "The file contains only %llu graph%s.\n", graphIndex.graphCount,
+                graphIndex.graphCount==1 ? "" : "s");
+        exit(1);
+    }
+    seekInput(indexOffsets == NULL ? 0 : indexOffsets[block]);
+    for(graph = block * graphIndex.interval + 1; graph <= last; graph++){
+        if(!skipGraph(graph >= first)){
+            fprintf(stderr, "The file contains only %llu graph%s.\n", graph - 1,
+                    graph==2 ? "" : "s");
+            exit(1);
+        }
+    }
+}
+
+//====================== USAGE =======================
+
+void help(char *name) {
+    fprintf(stderr, "The program %s builds an index for a file in planar code\n", name);
+    fprintf(stderr, "and writes the graphs with given ranks using this index.\n\n");
+    fprintf(stderr, "Usage\n=====\n");
+    fprintf(stderr, " %s [options] file\n\n", name);
+    fprintf(stderr, "\nThe index stores the offset of every K-th graph in the file. Without the\n");
+    fprintf(stderr, "option --ranks the index is built, otherwise it is used to find the graphs.\n");
+    fprintf(stderr, "When there is no index, the file is read from the start.\n\n");
+    fprintf(stderr, "Valid options\n=============\n");
+    fprintf(stderr, "    -h, --help\n");
+    fprintf(stderr, "       Print this help and return.\n");
+    fprintf(stderr, "    -i, --index file\n");
+    fprintf(stderr, "       The name of the index. The default is the name of the file followed\n");
+    fprintf(stderr, "       by .idx.\n");
+    fprintf(stderr, "    -k, --interval K\n");
+    fprintf(stderr, "       Store the offset of every K-th graph. The default is %d.\n", DEFAULTINTERVAL);
+    fprintf(stderr, "    -r, --ranks list\n");
+    fprintf(stderr, "       Write the graphs with the given ranks in planar code to standard out.\n");
+    fprintf(stderr, "       The list contains ranks and ranges of ranks separated by commas,\n");
+    fprintf(stderr, "       e.g., 5,17-20.\n");
+}
+
+void usage(char *name) {
+    fprintf(stderr, "Usage: %s [options] file\n", name);
+    fprintf(stderr, "For more information type: %s -h \n\n", name);
+}
+
+/* Parses the next range in the list of ranks and advances *list. Returns 0
+ * at the end of the list.
+ */
+int parseRange(char **list, unsigned long long *first, unsigned long long *last){
+    char *end;
+    if(**list == '\0'){
+        return 0;
+    }
+    *first = *last = strtoull(*list, &end, 10);
+    if(*end == '-'){
+        *last = strtoull(end + 1, &end, 10);
+    }
+    if(end == *list || (*end != ',' && *end != '\0') || *first < 1 || *last < *first){
+        fprintf(stderr, "Illegal list of ranks at %s.\n", *list);
+        exit(1);
+    }
+    *list = *end ? end + 1 : end;
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+
+    /*=========== commandline parsing ===========*/
+
+    int c;
+    char *name = argv[0];
+    static struct option long_options[] = {
+        {"help", no_argument, NULL, 'h'},
+        {"index", required_argument, NULL, 'i'},
+        {"interval", required_argument, NULL, 'k'},
+        {"ranks", required_argument, NULL, 'r'},
+        {NULL, 0, NULL, 0}
+    };
+    int option_index = 0;
+
+    char *indexName = NULL;
+    char *ranks = NULL;
+    long long interval = DEFAULTINTERVAL;
+
+    while ((c = getopt_long(argc, argv, "hi:k:r:", long_options, &option_index)) != -1) {
+        switch (c) {
+            case 'h':
+                help(name);
+                return EXIT_SUCCESS;
+            case 'i':
+                indexName = optarg;
+                break;
+            case 'k':
+                interval = atoll(optarg);
+                if(interval < 1){
+                    fprintf(stderr, "The interval should be positive.\n");
+                    usage(name);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'r':
+                ranks = optarg;
+                break;
+            case '?':
+                usage(name);
+                return EXIT_FAILURE;
+            default:
+                fprintf(stderr, "Illegal option %c.\n", c);
+                usage(name);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if(argc - optind != 1){
+        usage(name);
+        return EXIT_FAILURE;
+    }
+
+    inputFd = open(argv[optind], O_RDONLY);
+    if(inputFd < 0){
+        fprintf(stderr, "Could not open %s -- exiting!\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    if(indexName == NULL){
+        indexName = malloc(strlen(argv[optind]) + 5);
+        if(indexName == NULL){
+            fprintf(stderr, "Insufficient memory -- exiting!\n");
+            return EXIT_FAILURE;
+        }
+        strcpy(indexName, argv[optind]);
+        strcat(indexName, ".idx");
+    }
+
+    if(ranks == NULL){
+        buildIndex(indexName, interval);
+        return EXIT_SUCCESS;
+    }
+
+    if(!readIndex(indexName)){
+        fprintf(stderr, "No index found, reading %s from the start.\n", argv[optind]);
+        graphIndex.interval = -1;
+    }
+
+    unsigned long long first, last;
+    writeString(">>planar_code<<");
+    while(parseRange(&ranks, &first, &last)){
+        writeRanks(first, last);
+    }
+    flushOutput();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "progress.h"
+#include "input.h"
+
+static int *progressCounter;
+static int progressInterval;
+static PROGRESSREPORTER progressReporter;
+
+static double currentSeconds(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* Writes the fraction of the input that has been read and the estimated
+ * remaining time, if the input consists of regular files.
+ */
+static void reportInputPosition(FILE *f, double elapsed){
+    unsigned long long position, size;
+    if(!inputPosition(&position, &size) || position == 0){
+        return;
+    }
+    double fraction = (double)position / size;
+    fprintf(f, ", %.1f%% of input", 100 * fraction);
+    if(fraction < 1){
+        fprintf(f, ", ETA %.0f s", elapsed * (1 - fraction) / fraction);
+    }
+}
+
+static void *progressThread(void *arg){
+    sigset_t signals;
+    struct timespec timeout = {progressInterval, 0};
+    double start = currentSeconds(), last = start;
+    int lastCount = 0;
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+
+    while(1){
+        int signal = progressInterval ?
+                sigtimedwait(&signals, NULL, &timeout) :
+                sigwaitinfo(&signals, NULL);
+        if(signal < 0 && errno == EINTR){
+            continue;
+        }
+
+        double now = currentSeconds();
+        int count = __atomic_load_n(progressCounter, __ATOMIC_RELAXED);
+
+        flockfile(stderr);
+        fprintf(stderr, "Progress: %d graph%s in %.1f s, %.0f graphs/s",
+                count, count==1 ? "" : "s", now - start,
+                now > start ? count / (now - start) : 0);
+        if(now > last){
+            fprintf(stderr, " (%.0f graphs/s in the last %.1f s)",
+                    (count - lastCount) / (now - last), now - last);
+        }
+        reportInputPosition(stderr, now - start);
+        fprintf(stderr, "\n");
+        if(count == lastCount && now - last >= 1){
+            fprintf(stderr, "No graphs were read in the last %.1f s.\n", now - last);
+        }
+        if(progressReporter != NULL){
+            progressReporter(stderr);
+        }
+        funlockfile(stderr);
+
+        last = now;
+        lastCount = count;
+    }
+    return NULL;
+}
+
+void startProgress(int *graphCounter, int interval, PROGRESSREPORTER reporter){
+    sigset_t signals;
+    pthread_t thread;
+
+    progressCounter = graphCounter;
+    progressInterval = interval;
+    progressReporter = reporter;
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    if(pthread_create(&thread, NULL, progressThread, NULL)){
+        fprintf(stderr, "Could not start the progress thread -- exiting!\n");
+        exit(1);
+    }
+    pthread_detach(thread);
+}
@@ -0,0 +1,33 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+/* Progress reports for long runs. A separate thread waits for SIGUSR1 and
+ * (optionally) for a heartbeat interval to pass, and then writes the number of
+ * graphs read so far, the throughput, the ETA when the input consists of
+ * regular files and the partial results of the program to stderr. The main loop only
+ * increments its graph counter, so there is no overhead per graph.
+ *
+ * The report reads the counters of the main thread without synchronisation,
+ * so partial results can be slightly out of date.
+ */
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <stdio.h>
+
+/* Writes the partial results of the program to f. */
+typedef void (*PROGRESSREPORTER)(FILE *f);
+
+/* Starts the progress thread. graphCounter points to the number of graphs
+ * read so far. A report is written on SIGUSR1 and every interval seconds
+ * (never if interval is 0). The reporter may be NULL. This should be called
+ * before any other thread is started, so SIGUSR1 is blocked in all threads.
+ */
+void startProgress(int *graphCounter, int interval, PROGRESSREPORTER reporter);
+
+#endif /* PROGRESS_H */
@@ -0,0 +1,76 @@
+#!/bin/bash
+
+# Maintains the appearance matrix of the partitions of valid clusters: for each
+# partition and each number of vertices n, the number of fullerenes with that
+# partition and the rank of the first one. The results for one n are kept in
+# partitions/appearances_n.txt and are only computed again when they are
+# missing or older than the programs that produced them. The matrix itself is
+# written to partitions/matrix.txt, with the smallest n for each partition in
+# the second column.
+#
+#   ./appearance_matrix.sh [n ...]       update the matrix (by default for 20 and 24 up to 100)
+#   ./appearance_matrix.sh -q partition  print the smallest n in which the partition appears
+
+set -o pipefail
+
+MATRIX=partitions/matrix.txt
+
+if [ "$1" = "-q" ]; then
+    if [ ! -f $MATRIX ]; then
+        echo "No matrix found, run $0 first." >&2
+        exit 1
+    fi
+    awk -v p="$2" '$1 == p { print $2; found = 1 } END { exit !found }' $MATRIX
+    exit
+fi
+
+mkdir -p partitions
+
+if [ $# -eq 0 ]; then
+    set -- 20 $(seq 24 2 100)
+fi
+
+for n in "$@"
+  do
+    result=partitions/appearances_$n.txt
+    if [ -f $result ] && [ $result -nt "$(command -v pentagon_partition)" ] \
+            && [ $result -nt "$(command -v filter_valid_clusters)" ]; then
+        continue
+    fi
+    echo "Computing the partitions for $n vertices." >&2
+    if fullgen $n code 1 stdout logerr | pentagon_partition | filter_valid_clusters --first-rank > $result.tmp; then
+        mv $result.tmp $result
+    else
+        rm -f $result.tmp
+        echo "Could not compute the partitions for $n vertices." >&2
+        exit 1
+    fi
+  done
+
+# one row per partition, one column per n with count:rank, or - if the partition does not appear
+ls partitions/appearances_*.txt | sed 's/.*_\([0-9]*\)\.txt/\1/' | sort -n | while read n
+  do
+    sed "s/^/$n /" partitions/appearances_$n.txt
+  done | awk '
+    {
+        if (!($1 in seen)) { seen[$1] = 1; orders[++orderCount] = $1 }
+        partition = substr($2, 1, length($2) - 1)
+        if (!(partition in first)) { first[partition] = $1; partitions[++partitionCount] = partition }
+        cell[partition, $1] = $3 ":" $4
+    }
+    END {
+        printf "# partition first_n"
+        for (i = 1; i <= orderCount; i++) printf " %s", orders[i]
+        printf "\n"
+        for (p = 1; p <= partitionCount; p++) {
+            partition = partitions[p]
+            printf "%s %s", partition, first[partition]
+            for (i = 1; i <= orderCount; i++) {
+                value = cell[partition, orders[i]]
+                printf " %s", value == "" ? "-" : value
+            }
+            printf "\n"
+        }
+    }' > $MATRIX.tmp && mv $MATRIX.tmp $MATRIX
+
+echo `grep -vc '^#' $MATRIX` of 47 partitions appear.
@@ -0,0 +1,131 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "stats.h"
+#include "output.h"
+
+__thread STATISTICS stats;
+
+static FILE *reportFile = NULL; /* NULL means stderr */
+static STATISTICS *mainStats = NULL; /* the counters of the thread that called initStats */
+static unsigned long long workerOutputBytes = 0; /* the output written by the worker threads */
+
+static const char *stageNames[STAGECOUNT] = {
+    "read", "decode", "dual", "analysis", "output"
+};
+
+void initStats(const char *fileName){
+    stats.enabled = 1;
+    if(fileName != NULL){
+        reportFile = fopen(fileName, "w");
+        if(reportFile == NULL){
+            fprintf(stderr, "Could not open %s for the statistics -- exiting!\n", fileName);
+            exit(1);
+        }
+    }
+    stats.start = currentNanoseconds();
+    mainStats = &stats;
+}
+
+void initWorkerStats(){
+    if(mainStats == NULL) return;
+    memset(&stats, 0, sizeof(STATISTICS));
+    stats.enabled = 1;
+}
+
+static void addHistogram(unsigned long long *total, unsigned long long *histogram){
+    int i;
+    for(i = 0; i < HISTOGRAMSIZE; i++){
+        total[i] += histogram[i];
+    }
+}
+
+void mergeWorkerStats(){
+    int i;
+
+    if(!stats.enabled || &stats == mainStats) return;
+
+    for(i = 0; i < STAGECOUNT; i++){
+        mainStats->stageCalls[i] += stats.stageCalls[i];
+        mainStats->stageSamples[i] += stats.stageSamples[i];
+        mainStats->stageTime[i] += stats.stageTime[i];
+        if(stats.stageMax[i] > mainStats->stageMax[i]){
+            mainStats->stageMax[i] = stats.stageMax[i];
+        }
+    }
+    mainStats->graphs += stats.graphs;
+    mainStats->inputBytes += stats.inputBytes;
+    addHistogram(mainStats->nvHistogram, stats.nvHistogram);
+    addHistogram(mainStats->neHistogram, stats.neHistogram);
+    addHistogram(mainStats->codeLengthHistogram, stats.codeLengthHistogram);
+    workerOutputBytes += outputBuffer.written;
+}
+
+/* Writes the non-empty buckets of the histogram as a JSON object. */
+static void writeHistogram(FILE *f, const char *name, unsigned long long *histogram){
+    int i, first = 1;
+    fprintf(f, "    \"%s\": {", name);
+    for(i = 0; i < HISTOGRAMSIZE; i++){
+        if(histogram[i]){
+            fprintf(f, "%s\"%d%s\": %llu", first ? "" : ", ", i,
+                    i == HISTOGRAMSIZE - 1 ? "+" : "", histogram[i]);
+            first = 0;
+        }
+    }
+    fprintf(f, "}");
+}
+
+void finishStats(){
+    int i;
+
+    if(!stats.enabled) return;
+
+    double seconds = (currentNanoseconds() - stats.start) / 1e9;
+    if(seconds <= 0) seconds = 1e-9;
+
+    FILE *f = reportFile != NULL ? reportFile : stderr;
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"graphs\": %llu,\n", stats.graphs);
+    fprintf(f, "  \"seconds\": %.6f,\n", seconds);
+    fprintf(f, "  \"graphs_per_second\": %.0f,\n", stats.graphs / seconds);
+    fprintf(f, "  \"input_bytes\": %llu,\n", stats.inputBytes);
+    fprintf(f, "  \"input_bytes_per_second\": %.0f,\n", stats.inputBytes / seconds);
+    unsigned long long outputBytes = outputBuffer.written + workerOutputBytes;
+    fprintf(f, "  \"output_bytes\": %llu,\n", outputBytes);
+    fprintf(f, "  \"output_bytes_per_second\": %.0f,\n", outputBytes / seconds);
+    fprintf(f, "  \"sample_interval\": %d,\n", SAMPLEINTERVAL);
+    fprintf(f, "  \"stages\": {");
+    int first = 1;
+    for(i = 0; i < STAGECOUNT; i++){
+        if(!stats.stageCalls[i]) continue;
+        double mean = stats.stageSamples[i] ?
+                (double)stats.stageTime[i] / stats.stageSamples[i] : 0;
+        fprintf(f, "%s\n    \"%s\": {\"calls\": %llu, \"samples\": %llu, "
+                "\"mean_ns\": %.1f, \"max_ns\": %llu, \"estimated_total_ns\": %.0f}",
+                first ? "" : ",", stageNames[i], stats.stageCalls[i],
+                stats.stageSamples[i], mean, stats.stageMax[i],
+                mean * stats.stageCalls[i]);
+        first = 0;
+    }
+    fprintf(f, "\n  },\n");
+    fprintf(f, "  \"histograms\": {\n");
+    writeHistogram(f, "nv", stats.nvHistogram);
+    fprintf(f, ",\n");
+    writeHistogram(f, "ne", stats.neHistogram);
+    fprintf(f, ",\n");
+    writeHistogram(f, "code_length", stats.codeLengthHistogram);
+    fprintf(f, "\n  }\n}\n");
+
+    if(f != stderr){
+        fclose(f);
+    }
+}
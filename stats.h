@@ -0,0 +1,133 @@
+/*
+ * Main developer: Nico Van Cleemput
+ *
+ * Copyright (C) 2017 Ghent University.
+ * Licensed under the GNU AGPL, read the file LICENSE for details.
+ */
+
+/* Optional instrumentation for the programs (the option --stats). The main
+ * loop of a program calls startGraph before reading a graph and markStage
+ * after each stage. Only one graph in SAMPLEINTERVAL is timed, so the
+ * overhead stays small; the total time of a stage is estimated from the mean
+ * of the timed calls. When the instrumentation is disabled these calls only
+ * test a flag. Time spent waiting for input counts for the read stage; a
+ * large maximum for that stage usually means the program was waiting for its
+ * input and the estimate for the total is not reliable.
+ *
+ * At exit, finishStats writes a JSON report with the time per stage, the
+ * throughput and histograms of the number of vertices, the number of
+ * (oriented) edges and the code length.
+ *
+ * The counters are kept per thread. In a parallel run the worker threads add
+ * theirs to those of the main thread when they finish, so the time of a stage
+ * is summed over all threads and can exceed the time of the run.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <time.h>
+
+#define SAMPLEINTERVAL 64
+#define HISTOGRAMSIZE 1024 /* larger values are counted in the last bucket */
+
+#define STAGE_READ 0
+#define STAGE_DECODE 1
+#define STAGE_DUAL 2
+#define STAGE_ANALYSIS 3
+#define STAGE_OUTPUT 4
+#define STAGECOUNT 5
+
+typedef struct {
+    int enabled;
+    int sampling; /* whether the current graph is timed */
+    unsigned long long units; /* the number of calls to startGraph */
+    unsigned long long last; /* the time of the previous mark */
+    unsigned long long start;
+
+    unsigned long long stageCalls[STAGECOUNT];
+    unsigned long long stageSamples[STAGECOUNT];
+    unsigned long long stageTime[STAGECOUNT];
+    unsigned long long stageMax[STAGECOUNT];
+
+    unsigned long long graphs;
+    unsigned long long inputBytes;
+    unsigned long long nvHistogram[HISTOGRAMSIZE];
+    unsigned long long neHistogram[HISTOGRAMSIZE];
+    unsigned long long codeLengthHistogram[HISTOGRAMSIZE];
+} STATISTICS;
+
+extern __thread STATISTICS stats;
+
+/* Enables the instrumentation. The report is written to the file with the
+ * given name, or to stderr if fileName is NULL. Exits if the file cannot be
+ * opened.
+ */
+void initStats(const char *fileName);
+
+/* Writes the report if the instrumentation is enabled. */
+void finishStats();
+
+/* Enables the instrumentation on a worker thread if it is enabled. */
+void initWorkerStats();
+
+/* Adds the counters of a worker thread to those of the thread that called
+ * initStats. Calls on different threads must not run at the same time.
+ */
+void mergeWorkerStats();
+
+static inline unsigned long long currentNanoseconds(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static inline void startGraph(){
+    if(!stats.enabled) return;
+    stats.sampling = stats.units++ % SAMPLEINTERVAL == 0;
+    if(stats.sampling){
+        stats.last = currentNanoseconds();
+    }
+}
+
+/* Starts a part of the program that is timed once, e.g., writing the results
+ * at the end.
+ */
+static inline void startSection(){
+    if(!stats.enabled) return;
+    stats.sampling = 1;
+    stats.last = currentNanoseconds();
+}
+
+/* Attributes the time since the previous mark to the given stage. */
+static inline void markStage(int stage){
+    if(!stats.enabled) return;
+    stats.stageCalls[stage]++;
+    if(stats.sampling){
+        unsigned long long now = currentNanoseconds();
+        stats.stageTime[stage] += now - stats.last;
+        if(now - stats.last > stats.stageMax[stage]){
+            stats.stageMax[stage] = now - stats.last;
+        }
+        stats.stageSamples[stage]++;
+        stats.last = now;
+    }
+}
+
+static inline unsigned long long *histogramBucket(unsigned long long *histogram, int value){
+    return histogram + (value < HISTOGRAMSIZE ? value : HISTOGRAMSIZE - 1);
+}
+
+/* Records the size of a decoded graph. The number of bytes assumes that
+ * codes are only stored in the 16-bit format when the graph needs it.
+ */
+static inline void recordGraph(int nv, int ne, int codeLength){
+    if(!stats.enabled) return;
+    stats.graphs++;
+    stats.inputBytes += nv + 1 > 255 ? 2*codeLength + 1 : codeLength;
+    (*histogramBucket(stats.nvHistogram, nv))++;
+    (*histogramBucket(stats.neHistogram, ne))++;
+    (*histogramBucket(stats.codeLengthHistogram, codeLength))++;
+}
+
+#endif /* STATS_H */